@@ -0,0 +1,269 @@
+// bench.c
+// Load generator for the library server. Reuses the persistent-connection
+// logic from common.h (library_connect): N threads issue M mixed
+// Register/Lend/Return/AddBook commands each over keep-alive sockets and
+// report throughput plus p50/p99/p999 latency per command type.
+//
+// Usage: ./bench [num_threads] [ops_per_thread]   (defaults: 4 threads, 1000 ops)
+// The library must already be running on PORT.
+//
+// Scenario knobs for the perf regression suite (see builder perf mode):
+//   BENCH_CHURN=1    open and close a fresh connection per command instead
+//                    of reusing a keep-alive socket
+//   BENCH_CONTEND=1  every thread hammers one shared title instead of its
+//                    own, so Lend/Return fight over a single cache line
+//   BENCH_CSV=path   append one machine-readable result row to `path`
+//   BENCH_NAME=name  scenario label used in the CSV row
+#include "common.h"
+#include <time.h>
+#include <stdint.h>
+
+static int bench_churn = 0;
+static int bench_contend = 0;
+
+#define OP_REGISTER 0
+#define OP_LEND     1
+#define OP_RETURN   2
+#define OP_ADDBOOK  3
+#define NUM_OP_TYPES 4
+
+static const char *op_names[NUM_OP_TYPES] = { "Register", "Lend", "Return", "AddBook" };
+
+typedef struct {
+    int thread_id;
+    int num_ops;
+    // One latency sample (nanoseconds) per issued op, grouped by type
+    uint64_t *latencies[NUM_OP_TYPES];
+    int counts[NUM_OP_TYPES];
+    int failures;
+} BenchThread;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Send one newline-terminated command and wait for its newline-terminated
+// response. Returns 0 on success ("success..." reply), -1 otherwise.
+static int issue_command(int sock, const char *cmd, uint64_t *latency_ns) {
+    char request[BUFFER_SIZE];
+    char response[BUFFER_SIZE];
+    int len = snprintf(request, sizeof(request), "%s\n", cmd);
+
+    uint64_t t0 = now_ns();
+    if (send(sock, request, len, 0) < 0) return -1;
+
+    int resp_len = 0;
+    while (resp_len < BUFFER_SIZE - 1) {
+        ssize_t n = read(sock, response + resp_len, BUFFER_SIZE - 1 - resp_len);
+        if (n <= 0) return -1;
+        resp_len += n;
+        if (memchr(response, '\n', resp_len)) break;
+    }
+    *latency_ns = now_ns() - t0;
+
+    response[resp_len] = '\0';
+    return (strncmp(response, "success", 7) == 0) ? 0 : -1;
+}
+
+static void *bench_thread_main(void *arg) {
+    BenchThread *bt = (BenchThread*)arg;
+    char cmd[BUFFER_SIZE];
+    uint64_t lat;
+
+    int sock = library_connect();
+    if (sock < 0) {
+        fprintf(stderr, "bench thread %d: could not connect\n", bt->thread_id);
+        bt->failures = bt->num_ops;
+        return NULL;
+    }
+
+    // Each thread works against its own user and (unless the contended
+    // scenario is selected) its own book, so the default measures server
+    // throughput rather than deliberate title contention
+    char user[64], book[64];
+    snprintf(user, sizeof(user), "bench_user_%d", bt->thread_id);
+    if (bench_contend) {
+        snprintf(book, sizeof(book), "bench_contended");
+    } else {
+        snprintf(book, sizeof(book), "bench_book_%d", bt->thread_id);
+    }
+
+    snprintf(cmd, sizeof(cmd), "Register %s", user);
+    issue_command(sock, cmd, &lat);
+    if (!bench_contend) {
+        // The shared title is added once by main in the contended scenario
+        snprintf(cmd, sizeof(cmd), "AddBook %s", book);
+        issue_command(sock, cmd, &lat);
+    }
+    if (bench_churn) {
+        close(sock);
+        sock = -1;
+    }
+
+    for (int i = 0; i < bt->num_ops; i++) {
+        int op;
+        // Mixed workload: mostly Lend/Return pairs, some Register/AddBook
+        switch (i % 10) {
+            case 8:  op = OP_REGISTER; break;
+            case 9:  op = OP_ADDBOOK;  break;
+            default: op = (i % 2 == 0) ? OP_LEND : OP_RETURN; break;
+        }
+
+        switch (op) {
+            case OP_REGISTER:
+                snprintf(cmd, sizeof(cmd), "Register %s_%d", user, i);
+                break;
+            case OP_ADDBOOK:
+                snprintf(cmd, sizeof(cmd), "AddBook %s_%d", book, i);
+                break;
+            case OP_LEND:
+                snprintf(cmd, sizeof(cmd), "Lend %s %s", book, user);
+                break;
+            default:
+                snprintf(cmd, sizeof(cmd), "Return %s", book);
+                break;
+        }
+
+        // Connection churn scenario: the command pays a full TCP setup and
+        // teardown, like a client that does not keep its socket alive
+        if (bench_churn) {
+            sock = library_connect();
+            if (sock < 0) {
+                bt->failures++;
+                continue;
+            }
+        }
+
+        if (issue_command(sock, cmd, &lat) == 0) {
+            bt->latencies[op][bt->counts[op]++] = lat;
+        } else {
+            bt->failures++;
+        }
+
+        if (bench_churn) {
+            close(sock);
+            sock = -1;
+        }
+    }
+
+    if (sock >= 0) close(sock);
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(uint64_t *sorted, int n, double p) {
+    if (n == 0) return 0;
+    int idx = (int)(p * (n - 1));
+    return sorted[idx];
+}
+
+int main(int argc, char *argv[]) {
+    int num_threads = (argc > 1) ? atoi(argv[1]) : 4;
+    int num_ops = (argc > 2) ? atoi(argv[2]) : 1000;
+    if (num_threads <= 0 || num_ops <= 0) {
+        fprintf(stderr, "Usage: %s [num_threads] [ops_per_thread]\n", argv[0]);
+        return 1;
+    }
+
+    char *churn_env = getenv("BENCH_CHURN");
+    if (churn_env && atoi(churn_env) == 1) bench_churn = 1;
+    char *contend_env = getenv("BENCH_CONTEND");
+    if (contend_env && atoi(contend_env) == 1) bench_contend = 1;
+
+    printf("bench: %d threads x %d ops against 127.0.0.1:%d%s%s\n",
+           num_threads, num_ops, PORT,
+           bench_churn ? " (connection churn)" : "",
+           bench_contend ? " (contended title)" : "");
+
+    // The contended scenario's shared title is added once, up front, so the
+    // threads race on its availability flag rather than on AddBook
+    if (bench_contend) {
+        int sock = library_connect();
+        if (sock >= 0) {
+            uint64_t lat;
+            issue_command(sock, "AddBook bench_contended", &lat);
+            close(sock);
+        }
+    }
+
+    BenchThread *threads = calloc(num_threads, sizeof(BenchThread));
+    pthread_t *tids = calloc(num_threads, sizeof(pthread_t));
+    for (int i = 0; i < num_threads; i++) {
+        threads[i].thread_id = i;
+        threads[i].num_ops = num_ops;
+        for (int t = 0; t < NUM_OP_TYPES; t++) {
+            threads[i].latencies[t] = malloc(num_ops * sizeof(uint64_t));
+        }
+    }
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < num_threads; i++) {
+        pthread_create(&tids[i], NULL, bench_thread_main, &threads[i]);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    double elapsed_s = (now_ns() - start) / 1e9;
+
+    // Merge per-thread samples and report per command type; `all` collects
+    // every sample for the overall percentiles in the CSV row
+    long total_ops = 0, total_failures = 0;
+    uint64_t *all = malloc((size_t)num_threads * num_ops * sizeof(uint64_t));
+    long all_count = 0;
+    printf("\n%-10s %10s %12s %12s %12s\n",
+           "command", "count", "p50 (us)", "p99 (us)", "p999 (us)");
+    for (int t = 0; t < NUM_OP_TYPES; t++) {
+        int total = 0;
+        for (int i = 0; i < num_threads; i++) total += threads[i].counts[t];
+        uint64_t *merged = malloc((total > 0 ? total : 1) * sizeof(uint64_t));
+        int off = 0;
+        for (int i = 0; i < num_threads; i++) {
+            memcpy(merged + off, threads[i].latencies[t],
+                   threads[i].counts[t] * sizeof(uint64_t));
+            off += threads[i].counts[t];
+        }
+        memcpy(all + all_count, merged, (size_t)total * sizeof(uint64_t));
+        all_count += total;
+        qsort(merged, total, sizeof(uint64_t), cmp_u64);
+        printf("%-10s %10d %12.1f %12.1f %12.1f\n", op_names[t], total,
+               percentile(merged, total, 0.50) / 1000.0,
+               percentile(merged, total, 0.99) / 1000.0,
+               percentile(merged, total, 0.999) / 1000.0);
+        total_ops += total;
+        free(merged);
+    }
+    for (int i = 0; i < num_threads; i++) total_failures += threads[i].failures;
+
+    printf("\nthroughput: %.0f ops/sec (%ld ok, %ld failed, %.2f s elapsed)\n",
+           total_ops / elapsed_s, total_ops, total_failures, elapsed_s);
+
+    // One machine-readable row per run for the perf regression suite
+    char *csv_path = getenv("BENCH_CSV");
+    if (csv_path) {
+        qsort(all, all_count, sizeof(uint64_t), cmp_u64);
+        char *name = getenv("BENCH_NAME");
+        FILE *csv = fopen(csv_path, "a");
+        if (csv) {
+            fprintf(csv, "%s,%d,%d,%d,%d,%.0f,%.1f,%.1f\n",
+                    name ? name : "default", num_threads, num_ops,
+                    bench_churn, bench_contend, total_ops / elapsed_s,
+                    percentile(all, (int)all_count, 0.50) / 1000.0,
+                    percentile(all, (int)all_count, 0.99) / 1000.0);
+            fclose(csv);
+        }
+    }
+    free(all);
+
+    for (int i = 0; i < num_threads; i++) {
+        for (int t = 0; t < NUM_OP_TYPES; t++) free(threads[i].latencies[t]);
+    }
+    free(threads);
+    free(tids);
+    return 0;
+}
@@ -1,63 +1,416 @@
 // builder.c
+#define _GNU_SOURCE
 #include "common.h"
 #include <sys/wait.h>
 #include <signal.h>
+#include <sched.h>
 
-int main() {
-    // 1. Reset Log File
-    FILE *fp = fopen(LOG_FILE, "w");
-    if (fp) {
-        fprintf(fp, "=== Library Management System Simulation ===\n\n");
-        fclose(fp);
+// IMPROVEMENT: builder is now a load-generation driver, not a fixed two-user
+// demo. Usage:
+//   ./builder                          one client with user1.txt user2.txt
+//   ./builder N file1 file2 ...        N client processes, the files dealt
+//                                      round-robin across them
+//   ./builder N                        N client processes, each driving a
+//                                      generated synthetic workload
+// Client processes are pinned across cores, and the fixed startup sleep is
+// replaced by probing the listen port until the library accepts connections.
+
+#define MAX_CLIENTS 64
+#define MAX_FILES_PER_CLIENT 32
+
+// Poll a library instance's port until it accepts a connection (or time
+// out). Returns 0 once ready, -1 after ~5 seconds of failures.
+static int wait_for_library(int port) {
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    for (int attempt = 0; attempt < 50; attempt++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd >= 0 &&
+            connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            close(fd);
+            return 0;
+        }
+        if (fd >= 0) close(fd);
+        usleep(100000); // Not up yet, retry in 100ms
+    }
+    return -1;
+}
+
+// Write a synthetic user script: one Register/AddBook, then Lend/Return pairs
+static void generate_synthetic(const char *path, int id, int ops) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror("Synthetic workload create failed");
+        exit(1);
     }
+    fprintf(f, "Register synth_user_%d\n", id);
+    fprintf(f, "AddBook synth_book_%d\n", id);
+    for (int i = 0; i < ops; i += 2) {
+        fprintf(f, "Lend synth_book_%d synth_user_%d\n", id, id);
+        fprintf(f, "Return synth_book_%d\n", id);
+    }
+    fclose(f);
+}
 
-    write_log("BUILDER", "Simulation Started.");
+// --- Perf Regression Suite (`make perf` -> `./builder perf`) ---
+// Scenario matrix: {keep-alive, churn} x {uniform, contended} x client
+// thread counts. Each cell starts a fresh library, drives it with bench in
+// the matching mode (one CSV row per cell in perf_results.csv), then every
+// row's throughput is compared against the checked-in perf_baseline.csv.
+// A row below PERF_THRESHOLD (default 0.5) of its baseline fails the run,
+// so a nightly `make perf` catches large regressions while tolerating
+// machine-to-machine variance.
+#define PERF_RESULTS "perf_results.csv"
+#define PERF_BASELINE "perf_baseline.csv"
+
+// Run one matrix cell: fresh library, one bench process, clean teardown.
+// Returns 0 when bench completed, -1 otherwise.
+static int run_perf_scenario(const char *name, int threads, int ops,
+                             int churn, int contend) {
+    remove(SNAPSHOT_FILE);
+    remove(JOURNAL_FILE);
 
-    // 2. Fork Library Process
     pid_t lib_pid = fork();
     if (lib_pid == 0) {
-        // Child 1: Run Library
         execl("./library", "library", (char *)NULL);
         perror("Library exec failed");
         exit(1);
     } else if (lib_pid < 0) {
-        perror("Library fork failed");
+        return -1;
+    }
+    if (wait_for_library(PORT) < 0) {
+        kill(lib_pid, SIGTERM);
+        waitpid(lib_pid, NULL, 0);
+        return -1;
+    }
+
+    pid_t bench_pid = fork();
+    if (bench_pid == 0) {
+        char targ[16], oarg[16];
+        snprintf(targ, sizeof(targ), "%d", threads);
+        snprintf(oarg, sizeof(oarg), "%d", ops);
+        setenv("BENCH_NAME", name, 1);
+        setenv("BENCH_CSV", PERF_RESULTS, 1);
+        setenv("BENCH_CHURN", churn ? "1" : "0", 1);
+        setenv("BENCH_CONTEND", contend ? "1" : "0", 1);
+        execl("./bench", "bench", targ, oarg, (char *)NULL);
+        perror("Bench exec failed");
         exit(1);
     }
+    int bench_status = -1;
+    if (bench_pid > 0) waitpid(bench_pid, &bench_status, 0);
 
-    // Give library time to bind port and start listening
-    sleep(2);
+    kill(lib_pid, SIGTERM);
+    waitpid(lib_pid, NULL, 0);
 
-    // 3. Fork Client Process
-    pid_t client_pid = fork();
-    if (client_pid == 0) {
-        // Child 2: Run Client with user files
-        execl("./client", "client", "user1.txt", "user2.txt", (char *)NULL);
-        perror("Client exec failed");
-        exit(1);
-    } else if (client_pid < 0) {
-        perror("Client fork failed");
-        exit(1);
+    return (bench_pid > 0 && WIFEXITED(bench_status) &&
+            WEXITSTATUS(bench_status) == 0) ? 0 : -1;
+}
+
+// Baseline throughput for a scenario name, or -1 when it has no baseline
+static double baseline_throughput(const char *name) {
+    FILE *fp = fopen(PERF_BASELINE, "r");
+    if (!fp) return -1.0;
+
+    double result = -1.0;
+    char line[256], row_name[64];
+    double row_tput;
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%63[^,],%lf", row_name, &row_tput) == 2 &&
+            strcmp(row_name, name) == 0) {
+            result = row_tput;
+            break;
+        }
+    }
+    fclose(fp);
+    return result;
+}
+
+static int run_perf_suite(void) {
+    remove(PERF_RESULTS);
+
+    int ops = 2000;
+    char *ops_env = getenv("PERF_OPS");
+    if (ops_env && atoi(ops_env) > 0) ops = atoi(ops_env);
+
+    double threshold = 0.5;
+    char *thresh_env = getenv("PERF_THRESHOLD");
+    if (thresh_env && atof(thresh_env) > 0) threshold = atof(thresh_env);
+
+    static const int thread_counts[] = { 1, 2, 4 };
+    int failed_runs = 0;
+
+    for (int churn = 0; churn <= 1; churn++) {
+        for (int contend = 0; contend <= 1; contend++) {
+            for (size_t t = 0; t < sizeof(thread_counts) / sizeof(int); t++) {
+                char name[64];
+                snprintf(name, sizeof(name), "%s-%s-%d",
+                         churn ? "churn" : "keepalive",
+                         contend ? "contended" : "uniform",
+                         thread_counts[t]);
+                printf("perf: %s\n", name);
+                if (run_perf_scenario(name, thread_counts[t], ops,
+                                      churn, contend) < 0) {
+                    fprintf(stderr, "perf: %s did not complete\n", name);
+                    failed_runs++;
+                }
+            }
+        }
+    }
+
+    // Compare every measured row against its baseline
+    FILE *fp = fopen(PERF_RESULTS, "r");
+    if (!fp) {
+        fprintf(stderr, "perf: no results were produced\n");
+        return 1;
+    }
+    int regressions = 0, compared = 0;
+    char line[256], name[64];
+    int threads, nops, churn, contend;
+    double tput;
+    printf("\n%-24s %14s %14s  %s\n",
+           "scenario", "ops/sec", "baseline", "result");
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%63[^,],%d,%d,%d,%d,%lf",
+                   name, &threads, &nops, &churn, &contend, &tput) != 6) {
+            continue;
+        }
+        double base = baseline_throughput(name);
+        const char *verdict;
+        if (base < 0) {
+            verdict = "no baseline";
+        } else if (tput < base * threshold) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else {
+            verdict = "ok";
+        }
+        compared++;
+        printf("%-24s %14.0f %14.0f  %s\n", name, tput,
+               base < 0 ? 0.0 : base, verdict);
+    }
+    fclose(fp);
+
+    printf("\nperf: %d scenario(s), %d regression(s), %d failed run(s) "
+           "(threshold %.2fx baseline)\n",
+           compared, regressions, failed_runs, threshold);
+    return (regressions > 0 || failed_runs > 0) ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    // Perf regression mode: `./builder perf` runs the scenario matrix
+    // instead of the simulation
+    if (argc > 1 && strcmp(argv[1], "perf") == 0) {
+        return run_perf_suite();
+    }
+
+    // 1. Reset Log File
+    FILE *fp = fopen(LOG_FILE, "w");
+    if (fp) {
+        fprintf(fp, "=== Library Management System Simulation ===\n\n");
+        fclose(fp);
+    }
+
+    // Start each simulation from a clean slate: a snapshot or journal left
+    // over from a previous run would carry its users/books into this one
+    remove(SNAPSHOT_FILE);
+    remove(JOURNAL_FILE);
+    remove(EVENT_LOG_FILE);
+    for (int p = 1; p < MAX_SHARDS; p++) {
+        char path[80];
+        snprintf(path, sizeof(path), "%s.%d", SNAPSHOT_FILE, PORT + p);
+        remove(path);
+        snprintf(path, sizeof(path), "%s.%d", JOURNAL_FILE, PORT + p);
+        remove(path);
     }
 
-    // 4. Wait for client to finish
-    int client_status;
-    waitpid(client_pid, &client_status, 0);
-    
-    if (WIFEXITED(client_status)) {
-        write_log("BUILDER", "Client process exited successfully.");
+    // Parse the load topology
+    int num_clients = 1;
+    char **files = NULL;
+    int num_files = 0;
+    char synth_paths[MAX_CLIENTS][64];
+    static char *default_files[] = { "user1.txt", "user2.txt" };
+
+    if (argc > 1) {
+        num_clients = atoi(argv[1]);
+        if (num_clients < 1 || num_clients > MAX_CLIENTS) {
+            fprintf(stderr, "Usage: %s [num_clients] [user files...]\n", argv[0]);
+            return 1;
+        }
+        files = argv + 2;
+        num_files = argc - 2;
+        // More clients than user files would exec file-less clients that
+        // fail their usage check and exit immediately; clamp to the number
+        // of real workloads instead
+        if (num_files > 0 && num_clients > num_files) {
+            fprintf(stderr, "builder: only %d user file(s), running %d "
+                    "client(s) instead of %d\n", num_files, num_files,
+                    num_clients);
+            num_clients = num_files;
+        }
+        if (num_files == 0) {
+            // No files given: synthesize one workload per client
+            int ops = 50;
+            char *ops_env = getenv("BUILDER_SYNTH_OPS");
+            if (ops_env && atoi(ops_env) > 0) ops = atoi(ops_env);
+            for (int i = 0; i < num_clients; i++) {
+                snprintf(synth_paths[i], sizeof(synth_paths[i]),
+                         "synth_user_%d.txt", i);
+                generate_synthetic(synth_paths[i], i, ops);
+            }
+        }
     } else {
-        write_log("BUILDER", "Client process terminated abnormally.");
+        files = default_files;
+        num_files = 2;
     }
 
-    // 5. Give library a moment to finish pending requests, then kill it
-    sleep(1);
-    kill(lib_pid, SIGTERM);
-    
-    int lib_status;
-    waitpid(lib_pid, &lib_status, 0);
-    
-    if (WIFEXITED(lib_status)) {
+    write_log("BUILDER", "Simulation Started.");
+
+    // IMPROVEMENT: Readiness handshake. The library inherits the write end
+    // of this pipe (fd number passed via LIBRARY_READY_FD) and writes one
+    // byte the moment its listen sockets are live, so the clients start with
+    // zero polling delay. The port probe stays as a fallback.
+    int ready_pipe[2];
+    if (pipe(ready_pipe) < 0) {
+        ready_pipe[0] = ready_pipe[1] = -1;
+    }
+
+    // 2. Fork Library Process(es). IMPROVEMENT: With LIBRARY_SHARDS=N the
+    // catalog is sharded across N instances on consecutive ports; the
+    // clients inherit the same variable and route commands by title hash
+    int num_lib = 1;
+    char *shards_env = getenv("LIBRARY_SHARDS");
+    if (shards_env && atoi(shards_env) > 1 && atoi(shards_env) <= MAX_SHARDS) {
+        num_lib = atoi(shards_env);
+    }
+
+    pid_t lib_pids[MAX_SHARDS];
+    for (int i = 0; i < num_lib; i++) {
+        lib_pids[i] = fork();
+        if (lib_pids[i] == 0) {
+            if (ready_pipe[1] >= 0) {
+                close(ready_pipe[0]);
+                char fd_str[16];
+                snprintf(fd_str, sizeof(fd_str), "%d", ready_pipe[1]);
+                setenv("LIBRARY_READY_FD", fd_str, 1);
+            }
+            if (num_lib > 1) {
+                char port_str[16];
+                snprintf(port_str, sizeof(port_str), "%d", PORT + i);
+                setenv("LIBRARY_PORT", port_str, 1);
+            }
+            execl("./library", "library", (char *)NULL);
+            perror("Library exec failed");
+            exit(1);
+        } else if (lib_pids[i] < 0) {
+            perror("Library fork failed");
+            exit(1);
+        }
+    }
+
+    // Wait for one readiness byte per instance (bounded, in case a library
+    // dies during startup); fall back to probing the ports if the handshake
+    // fails
+    int ready = 0;
+    if (ready_pipe[0] >= 0) {
+        close(ready_pipe[1]);
+        while (ready < num_lib) {
+            fd_set rfds;
+            struct timeval tv = { 5, 0 };
+            FD_ZERO(&rfds);
+            FD_SET(ready_pipe[0], &rfds);
+            if (select(ready_pipe[0] + 1, &rfds, NULL, NULL, &tv) <= 0) break;
+            char byte;
+            if (read(ready_pipe[0], &byte, 1) != 1) break;
+            ready++;
+        }
+        close(ready_pipe[0]);
+    }
+    if (ready < num_lib) {
+        int probed = 0;
+        for (int i = 0; i < num_lib; i++) {
+            if (wait_for_library(PORT + i) == 0) probed++;
+        }
+        if (probed < num_lib) {
+            write_log("BUILDER", "Library did not become ready, aborting.");
+            for (int i = 0; i < num_lib; i++) {
+                kill(lib_pids[i], SIGTERM);
+                waitpid(lib_pids[i], NULL, 0);
+            }
+            return 1;
+        }
+    }
+    write_log("BUILDER", "Library is ready, starting clients.");
+
+    // 3. Fork Client Processes, each with its slice of the user files and
+    // pinned to a core so load generation spreads across the machine
+    long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cores < 1) num_cores = 1;
+
+    pid_t client_pids[MAX_CLIENTS];
+    for (int c = 0; c < num_clients; c++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(c % num_cores, &cpus);
+            sched_setaffinity(0, sizeof(cpus), &cpus);
+
+            // Deal the files round-robin: client c takes files c, c+N, ...
+            char *client_argv[MAX_FILES_PER_CLIENT + 2];
+            int client_argc = 0;
+            client_argv[client_argc++] = "client";
+            if (num_files > 0) {
+                for (int i = c; i < num_files &&
+                     client_argc <= MAX_FILES_PER_CLIENT; i += num_clients) {
+                    client_argv[client_argc++] = files[i];
+                }
+            } else {
+                client_argv[client_argc++] = synth_paths[c];
+            }
+            client_argv[client_argc] = NULL;
+
+            execv("./client", client_argv);
+            perror("Client exec failed");
+            exit(1);
+        } else if (pid < 0) {
+            perror("Client fork failed");
+            exit(1);
+        }
+        client_pids[c] = pid;
+    }
+
+    // 4. Wait for every client to finish
+    int failures = 0;
+    for (int c = 0; c < num_clients; c++) {
+        int client_status;
+        waitpid(client_pids[c], &client_status, 0);
+        if (!WIFEXITED(client_status) || WEXITSTATUS(client_status) != 0) {
+            failures++;
+        }
+    }
+    char client_msg[128];
+    snprintf(client_msg, sizeof(client_msg),
+             "%d client process(es) finished (%d abnormal).",
+             num_clients, failures);
+    write_log("BUILDER", client_msg);
+
+    // 5. Stop the library instances. No settling sleep needed: every client
+    // has exited, and the server drains anything still in flight on SIGTERM
+    int lib_failures = 0;
+    for (int i = 0; i < num_lib; i++) {
+        kill(lib_pids[i], SIGTERM);
+    }
+    for (int i = 0; i < num_lib; i++) {
+        int lib_status;
+        waitpid(lib_pids[i], &lib_status, 0);
+        if (!WIFEXITED(lib_status)) lib_failures++;
+    }
+
+    if (lib_failures == 0) {
         write_log("BUILDER", "Library process exited successfully.");
     } else {
         write_log("BUILDER", "Library process terminated.");
@@ -65,6 +418,6 @@ int main() {
 
     write_log("BUILDER", "Simulation Finished.");
     printf("Simulation complete. Check log.txt for details.\n");
-    
+
     return 0;
 }
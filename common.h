@@ -15,15 +15,114 @@
 #include <errno.h>
 #include <signal.h>
 #include <sys/select.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <time.h>
 
 #define PORT 8080
 #define BUFFER_SIZE 1024
 #define LOG_FILE "log.txt"
+#define SNAPSHOT_FILE "library.snap"
+#define JOURNAL_FILE "library.journal"
 
 // Mutex to protect file locking within the same process
 static pthread_mutex_t log_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+// IMPROVEMENT: Async logging mode (LOG_ASYNC=1). Log lines are queued in an
+// in-memory ring buffer and drained by a dedicated logger thread that keeps
+// one fd open and writes whole batches under a single flock, instead of
+// paying open/flock/write/close per message on the hot path.
+#define LOG_QUEUE_SIZE 512
+#define LOG_MSG_MAX 512
+
+static char log_queue[LOG_QUEUE_SIZE][LOG_MSG_MAX];
+static int log_q_head = 0, log_q_tail = 0, log_q_count = 0;
+static pthread_cond_t log_q_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t log_q_not_full = PTHREAD_COND_INITIALIZER;
+static int log_async = 0;          // 1 once the logger thread is running
+static int log_stopping = 0;       // Tells the logger thread to drain and exit
+static int log_fd_async = -1;      // Kept open for the life of the process
+static pthread_t log_thread;
+static pthread_once_t log_init_once = PTHREAD_ONCE_INIT;
+
+static void *logger_main(void *arg) {
+    (void)arg;
+    char batch[LOG_QUEUE_SIZE * LOG_MSG_MAX / 8]; // Plenty for one drain
+    for (;;) {
+        pthread_mutex_lock(&log_mutex);
+        while (log_q_count == 0 && !log_stopping) {
+            pthread_cond_wait(&log_q_not_empty, &log_mutex);
+        }
+        if (log_q_count == 0 && log_stopping) {
+            pthread_mutex_unlock(&log_mutex);
+            break;
+        }
+
+        // Drain as many queued lines as fit into one batch
+        size_t batch_len = 0;
+        while (log_q_count > 0) {
+            size_t len = strlen(log_queue[log_q_head]);
+            if (batch_len + len >= sizeof(batch)) break;
+            memcpy(batch + batch_len, log_queue[log_q_head], len);
+            batch_len += len;
+            log_q_head = (log_q_head + 1) % LOG_QUEUE_SIZE;
+            log_q_count--;
+        }
+        pthread_cond_broadcast(&log_q_not_full);
+        pthread_mutex_unlock(&log_mutex);
+
+        // One flock + one write per batch, not per line
+        flock(log_fd_async, LOCK_EX);
+        write(log_fd_async, batch, batch_len);
+        flock(log_fd_async, LOCK_UN);
+    }
+    return NULL;
+}
+
+// Drain remaining lines and stop the logger thread (registered via atexit)
+static void log_async_shutdown(void) {
+    pthread_mutex_lock(&log_mutex);
+    log_stopping = 1;
+    pthread_cond_broadcast(&log_q_not_empty);
+    pthread_mutex_unlock(&log_mutex);
+    pthread_join(log_thread, NULL);
+    close(log_fd_async);
+}
+
+static void log_async_init(void) {
+    if (getenv("LOG_ASYNC") == NULL || atoi(getenv("LOG_ASYNC")) != 1) return;
+    log_fd_async = open(LOG_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (log_fd_async == -1) {
+        perror("Log Open Error");
+        return; // Fall back to synchronous logging
+    }
+    if (pthread_create(&log_thread, NULL, logger_main, NULL) != 0) {
+        close(log_fd_async);
+        log_fd_async = -1;
+        return;
+    }
+    atexit(log_async_shutdown);
+    log_async = 1;
+}
+
 void write_log(const char *process_name, const char *message) {
+    pthread_once(&log_init_once, log_async_init);
+
+    if (log_async) {
+        // Queue the formatted line; the logger thread does the file I/O
+        pthread_mutex_lock(&log_mutex);
+        while (log_q_count == LOG_QUEUE_SIZE) {
+            pthread_cond_wait(&log_q_not_full, &log_mutex);
+        }
+        snprintf(log_queue[log_q_tail], LOG_MSG_MAX, "[%s] %s\n",
+                 process_name, message);
+        log_q_tail = (log_q_tail + 1) % LOG_QUEUE_SIZE;
+        log_q_count++;
+        pthread_cond_signal(&log_q_not_empty);
+        pthread_mutex_unlock(&log_mutex);
+        return;
+    }
+
     pthread_mutex_lock(&log_mutex); // Protect threads in THIS process
 
     int fd = open(LOG_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
@@ -35,7 +134,7 @@ void write_log(const char *process_name, const char *message) {
 
     // Lock file for INTER-PROCESS safety
     flock(fd, LOCK_EX);
-    
+
     char buffer[BUFFER_SIZE];
     snprintf(buffer, sizeof(buffer), "[%s] %s\n", process_name, message);
     write(fd, buffer, strlen(buffer));
@@ -45,6 +144,411 @@ void write_log(const char *process_name, const char *message) {
 
     pthread_mutex_unlock(&log_mutex);
 }
+// --- Binary Event Log ---
+// IMPROVEMENT: Text logging pays snprintf formatting on the hot path and
+// produces lines that are expensive to post-process. With LOG_BINARY=1 the
+// request/response trace is written as fixed-size binary records instead --
+// a monotonic timestamp, a component id, an event id and a small payload --
+// batched in memory and appended with one flock+write per batch, the same
+// discipline the async text logger uses. The logdump tool renders the
+// records to text offline, where formatting cost no longer matters.
+#define EVENT_LOG_FILE "log.events"
+#define EVENT_PAYLOAD_MAX 40
+#define EVENT_BUF_RECORDS 256
+
+// Component ids
+#define COMP_LIBRARY 1
+#define COMP_CLIENT  2
+#define COMP_BUILDER 3
+
+// Event ids
+#define EV_REQUEST  1
+#define EV_RESPONSE 2
+#define EV_STARTUP  3
+#define EV_SHUTDOWN 4
+
+typedef struct {
+    uint64_t ts_ns;       // CLOCK_MONOTONIC at record time
+    uint16_t component;
+    uint16_t event;
+    uint32_t payload_len; // Bytes of payload actually used
+    char payload[EVENT_PAYLOAD_MAX];
+} EventRecord;
+
+static int event_log_fd = -1;
+static int event_log_state = -1; // -1 unresolved, 0 disabled, 1 enabled
+static pthread_mutex_t event_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static EventRecord event_log_buf[EVENT_BUF_RECORDS];
+static int event_log_count = 0;
+
+// One flock + one write per batch of records (caller holds event_log_mutex)
+static void event_log_flush_locked(void) {
+    if (event_log_count == 0) return;
+    flock(event_log_fd, LOCK_EX);
+    write(event_log_fd, event_log_buf,
+          (size_t)event_log_count * sizeof(EventRecord));
+    flock(event_log_fd, LOCK_UN);
+    event_log_count = 0;
+}
+
+// Drain buffered records at exit (registered via atexit)
+static void event_log_shutdown(void) {
+    pthread_mutex_lock(&event_log_mutex);
+    event_log_flush_locked();
+    close(event_log_fd);
+    event_log_fd = -1;
+    pthread_mutex_unlock(&event_log_mutex);
+}
+
+// Returns 1 when binary event logging is active (resolved once per process)
+static int event_log_active(void) {
+    if (event_log_state == -1) {
+        pthread_mutex_lock(&event_log_mutex);
+        if (event_log_state == -1) {
+            char *env = getenv("LOG_BINARY");
+            if (env && atoi(env) == 1) {
+                event_log_fd = open(EVENT_LOG_FILE,
+                                    O_WRONLY | O_CREAT | O_APPEND, 0644);
+            }
+            if (event_log_fd >= 0) {
+                atexit(event_log_shutdown);
+                event_log_state = 1;
+            } else {
+                event_log_state = 0;
+            }
+        }
+        pthread_mutex_unlock(&event_log_mutex);
+    }
+    return event_log_state;
+}
+
+// Append one record; no-op unless LOG_BINARY=1
+static inline void log_event(uint16_t component, uint16_t event, const char *payload) {
+    if (!event_log_active()) return;
+
+    EventRecord rec;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    rec.ts_ns = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    rec.component = component;
+    rec.event = event;
+    size_t len = payload ? strlen(payload) : 0;
+    if (len > EVENT_PAYLOAD_MAX) len = EVENT_PAYLOAD_MAX;
+    rec.payload_len = (uint32_t)len;
+    memset(rec.payload, 0, EVENT_PAYLOAD_MAX);
+    if (len) memcpy(rec.payload, payload, len);
+
+    pthread_mutex_lock(&event_log_mutex);
+    if (event_log_count == EVENT_BUF_RECORDS) event_log_flush_locked();
+    event_log_buf[event_log_count++] = rec;
+    pthread_mutex_unlock(&event_log_mutex);
+}
+
+// --- Zero-copy Tokenizer ---
+// IMPROVEMENT: Request and config lines used to go through sscanf plus
+// memsets into fixed 50-byte buffers. These helpers find token boundaries in
+// the existing buffer instead: no copies, no format-string interpretation.
+
+// Non-mutating variant: token start/length spans into the original line
+typedef struct {
+    const char *p;
+    size_t len;
+} Token;
+
+static inline int tokenize(const char *line, Token tokens[], int max_tokens) {
+    int n = 0;
+    while (n < max_tokens) {
+        while (*line == ' ' || *line == '\t') line++;
+        if (*line == '\0') break;
+        tokens[n].p = line;
+        while (*line && *line != ' ' && *line != '\t') line++;
+        tokens[n].len = (size_t)(line - tokens[n].p);
+        n++;
+    }
+    return n;
+}
+
+static inline int token_eq(Token t, const char *s) {
+    size_t len = strlen(s);
+    return t.len == len && memcmp(t.p, s, len) == 0;
+}
+
+// Mutating variant for buffers the caller owns: terminates each token in
+// place so existing NUL-terminated-string code can consume them directly
+static inline int tokenize_inplace(char *line, char *tokens[], int max_tokens) {
+    int n = 0;
+    while (n < max_tokens) {
+        while (*line == ' ' || *line == '\t') line++;
+        if (*line == '\0') break;
+        tokens[n++] = line;
+        while (*line && *line != ' ' && *line != '\t') line++;
+        if (*line) *line++ = '\0';
+    }
+    return n;
+}
+
+// Connect to a library instance with retries; returns the socket or -1
+static int library_connect_port(int port) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) {
+        write_log("CLIENT_ERR", "Socket creation error");
+        return -1;
+    }
+
+    struct sockaddr_in serv_addr;
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(port);
+
+    if (inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr) <= 0) {
+        write_log("CLIENT_ERR", "Invalid address conversion");
+        close(sock);
+        return -1;
+    }
+
+    // Try to connect with retries
+    int retry_count = 0;
+    while (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
+        retry_count++;
+        if (retry_count > 5) {
+            write_log("CLIENT_ERR", "Connection failed after retries");
+            close(sock);
+            return -1;
+        }
+        usleep(100000); // Wait 100ms before retry
+    }
+    return sock;
+}
+
+static int library_connect(void) {
+    return library_connect_port(PORT);
+}
+
+// --- Client-side Catalog Sharding ---
+// IMPROVEMENT: LIBRARY_SHARDS=N spreads the catalog across N library
+// instances listening on consecutive ports (PORT .. PORT+N-1), each owning
+// the titles whose hash falls in its range. The client routes each
+// title-bearing command to the owning instance over one persistent
+// connection per shard; Register fans out to every shard so any instance
+// can validate the user later. AddBook and Lend for different hash ranges
+// then run on separate processes with no shared locks at all.
+#define MAX_SHARDS 8
+
+// djb2 over a token span; must be stable across client and server versions
+// only in that all clients agree on it
+static inline unsigned long shard_hash(const char *s, size_t len) {
+    unsigned long h = 5381;
+    for (size_t i = 0; i < len; i++) h = ((h << 5) + h) + (unsigned char)s[i];
+    return h;
+}
+
+static inline int client_num_shards(void) {
+    char *env = getenv("LIBRARY_SHARDS");
+    int n = env ? atoi(env) : 1;
+    if (n < 1) n = 1;
+    if (n > MAX_SHARDS) n = MAX_SHARDS;
+    return n;
+}
+
+// One command round-trip on a shard's persistent connection (lazily opened).
+// Returns 0 on success, -1 when the shard cannot be reached; response always
+// holds a printable result either way.
+static int shard_request(int shard_socks[], int shard, const char *line,
+                         char *response, size_t response_cap) {
+    if (shard_socks[shard] < 0) {
+        shard_socks[shard] = library_connect_port(PORT + shard);
+        if (shard_socks[shard] < 0) {
+            snprintf(response, response_cap, "failure (shard unreachable)");
+            return -1;
+        }
+    }
+
+    char request[BUFFER_SIZE];
+    int len = snprintf(request, sizeof(request), "%s\n", line);
+    send(shard_socks[shard], request, len, 0);
+
+    ssize_t n = read(shard_socks[shard], response, response_cap - 1);
+    if (n <= 0) {
+        close(shard_socks[shard]);
+        shard_socks[shard] = -1;
+        snprintf(response, response_cap, "failure (shard connection lost)");
+        return -1;
+    }
+    response[n] = '\0';
+    response[strcspn(response, "\n")] = '\0';
+    return 0;
+}
+
+// --- Shared-memory Transport (co-located fast path) ---
+// IMPROVEMENT: When client and library run on the same host (LIBRARY_SHM=1
+// on both sides), commands travel through a request/response channel in a
+// shared-memory segment instead of the TCP stack. Wakeups use process-shared
+// mutexes and condition variables, which Linux implements on top of futexes,
+// so an idle channel costs nothing and a round-trip is two futex wakes and
+// two small copies. Negotiation is implicit: a client that cannot attach the
+// segment (remote host, library not started with LIBRARY_SHM=1, or all
+// channels claimed) silently falls back to TCP.
+#define SHM_NAME "/library_shm"
+#define SHM_CHANNELS 8
+#define SHM_MAGIC 0x4C534843u
+
+typedef struct {
+    pthread_mutex_t lock;      // Robust: survives a holder dying mid-critical-section
+    pthread_cond_t req_ready;  // Client -> library: a request is waiting
+    pthread_cond_t resp_ready; // Library -> client: the response is in place
+    int claimed;               // 1 while a client thread owns this channel
+    pid_t owner_pid;           // Claiming process, so the library can reclaim
+                               // channels whose owner exited without releasing
+    int has_request;
+    int has_response;
+    char request[BUFFER_SIZE];
+    char response[BUFFER_SIZE];
+} ShmChannel;
+
+// Reset a channel to its unclaimed idle state (caller holds ch->lock)
+static inline void shm_channel_reset(ShmChannel *ch) {
+    ch->claimed = 0;
+    ch->owner_pid = 0;
+    ch->has_request = ch->has_response = 0;
+}
+
+// Lock a channel's robust mutex. EOWNERDEAD means a process died while
+// holding it and we now own the lock over state of unknown integrity: mark
+// the mutex consistent and reset the channel so the slot stays usable.
+// Returns the pthread_mutex_lock result (EOWNERDEAD included, lock held).
+static inline int shm_channel_lock(ShmChannel *ch) {
+    int rc = pthread_mutex_lock(&ch->lock);
+    if (rc == EOWNERDEAD) {
+        pthread_mutex_consistent(&ch->lock);
+        shm_channel_reset(ch);
+    }
+    return rc;
+}
+
+typedef struct {
+    uint32_t magic; // Written last: the segment is usable once this matches
+    int num_channels;
+    ShmChannel channels[SHM_CHANNELS];
+} ShmSegment;
+
+// Attach the library's segment once per process (client side)
+static ShmSegment *shm_client_segment(void) {
+    static pthread_mutex_t attach_mutex = PTHREAD_MUTEX_INITIALIZER;
+    static ShmSegment *seg = NULL;
+    static int attach_tried = 0;
+
+    pthread_mutex_lock(&attach_mutex);
+    if (!attach_tried) {
+        attach_tried = 1;
+        char *env = getenv("LIBRARY_SHM");
+        if (env && atoi(env) == 1) {
+            int fd = shm_open(SHM_NAME, O_RDWR, 0);
+            if (fd >= 0) {
+                void *map = mmap(NULL, sizeof(ShmSegment),
+                                 PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                close(fd);
+                if (map != MAP_FAILED &&
+                    ((ShmSegment*)map)->magic == SHM_MAGIC) {
+                    seg = (ShmSegment*)map;
+                } else if (map != MAP_FAILED) {
+                    munmap(map, sizeof(ShmSegment));
+                }
+            }
+        }
+    }
+    pthread_mutex_unlock(&attach_mutex);
+    return seg;
+}
+
+// Claim a free channel for this thread; NULL means use TCP instead
+static ShmChannel *shm_channel_claim(void) {
+    ShmSegment *seg = shm_client_segment();
+    if (!seg) return NULL;
+    for (int i = 0; i < seg->num_channels; i++) {
+        ShmChannel *ch = &seg->channels[i];
+        shm_channel_lock(ch);
+        if (!ch->claimed) {
+            ch->claimed = 1;
+            ch->owner_pid = getpid();
+            ch->has_request = ch->has_response = 0;
+            pthread_mutex_unlock(&ch->lock);
+            return ch;
+        }
+        pthread_mutex_unlock(&ch->lock);
+    }
+    return NULL; // All channels busy; TCP absorbs the overflow
+}
+
+static void shm_channel_release(ShmChannel *ch) {
+    shm_channel_lock(ch);
+    shm_channel_reset(ch);
+    pthread_mutex_unlock(&ch->lock);
+}
+
+// One blocking command round-trip over the channel
+static void shm_channel_request(ShmChannel *ch, const char *line,
+                                char *response, size_t response_cap) {
+    if (shm_channel_lock(ch) == EOWNERDEAD) {
+        // The servicing thread died holding the channel; nothing will answer
+        pthread_mutex_unlock(&ch->lock);
+        snprintf(response, response_cap, "failure (shm channel lost)");
+        return;
+    }
+    snprintf(ch->request, sizeof(ch->request), "%s", line);
+    ch->has_request = 1;
+    pthread_cond_signal(&ch->req_ready);
+    while (!ch->has_response) {
+        if (pthread_cond_wait(&ch->resp_ready, &ch->lock) == EOWNERDEAD) {
+            pthread_mutex_consistent(&ch->lock);
+            shm_channel_reset(ch);
+            pthread_mutex_unlock(&ch->lock);
+            snprintf(response, response_cap, "failure (shm channel lost)");
+            return;
+        }
+    }
+    snprintf(response, response_cap, "%s", ch->response);
+    ch->has_response = 0;
+    pthread_mutex_unlock(&ch->lock);
+}
+
+// IMPROVEMENT: Pipelined mode (CLIENT_PIPELINE=K). Instead of waiting one
+// round-trip per command, the user thread writes up to K commands ahead on
+// the persistent socket and matches responses as they stream back. Sleep
+// lines act as a pipeline barrier.
+#define MAX_PIPELINE 64
+
+// Session tokens a user thread has learned from Register responses
+#define MAX_SESSIONS 8
+
+// Match `count` in-flight commands with their newline-terminated responses,
+// logging each pair in order. `acc`/`acc_len` carry partial response data
+// across calls.
+static void drain_pipeline(int sock, char pending[][256], int count,
+                           char *acc, int *acc_len, size_t acc_cap) {
+    char log_buf[BUFFER_SIZE];
+    int done = 0;
+    while (done < count) {
+        char *nl;
+        while (done < count && (nl = memchr(acc, '\n', *acc_len)) != NULL) {
+            *nl = '\0';
+            snprintf(log_buf, sizeof(log_buf), "Command: %s | Response: %s",
+                     pending[done], acc);
+            write_log("CLIENT_THREAD", log_buf);
+            int line_len = (int)(nl - acc) + 1;
+            memmove(acc, nl + 1, *acc_len - line_len);
+            *acc_len -= line_len;
+            done++;
+        }
+        if (done >= count) break;
+
+        ssize_t n = read(sock, acc + *acc_len, acc_cap - *acc_len - 1);
+        if (n <= 0) {
+            write_log("CLIENT_ERR", "Pipeline response read failed");
+            return;
+        }
+        *acc_len += n;
+    }
+}
+
 // Thread function for ONE user
 void *simulate_user(void *arg) {
     char *config_file = (char*)arg;
@@ -65,6 +569,44 @@ void *simulate_user(void *arg) {
     int sock = -1;
     int connected = 0;
 
+    // Shared-memory channel, claimed lazily on the first command; stays
+    // NULL (TCP) when the library is remote or not exporting the segment
+    ShmChannel *shm_ch = NULL;
+    int shm_tried = 0;
+
+    // Sharded mode: one persistent connection per catalog shard
+    int num_shards = client_num_shards();
+    int shard_socks[MAX_SHARDS];
+    for (int i = 0; i < MAX_SHARDS; i++) shard_socks[i] = -1;
+
+    // IMPROVEMENT: Batch mode. Commands between BatchBegin and BatchEnd in
+    // the user file are sent as one payload and their responses are read
+    // back in order in one round-trip.
+    int batching = 0;
+    int batch_count = 0;
+    size_t batch_len = 0;
+    char batch_buf[BUFFER_SIZE * 4];
+
+    // Pipelined mode state (window size via CLIENT_PIPELINE, default 1 =
+    // lock-step)
+    int pipeline = 1;
+    char *pipe_env = getenv("CLIENT_PIPELINE");
+    if (pipe_env && atoi(pipe_env) > 1 && atoi(pipe_env) <= MAX_PIPELINE) {
+        pipeline = atoi(pipe_env);
+    }
+    char pending[MAX_PIPELINE][256];
+    int pending_count = 0;
+    char resp_acc[BUFFER_SIZE * 4];
+    int resp_acc_len = 0;
+
+    // IMPROVEMENT: Session tokens. The id in a Register response is
+    // remembered per name; later Lend commands present it as "#<id>" and the
+    // server resolves the user with a direct array index instead of a locked
+    // hash lookup.
+    char session_names[MAX_SESSIONS][64];
+    int session_tokens[MAX_SESSIONS];
+    int session_count = 0;
+
     char line[256];
     while (fgets(line, sizeof(line), fp)) {
         // Remove newline
@@ -73,14 +615,95 @@ void *simulate_user(void *arg) {
         // Skip empty lines
         if (strlen(line) == 0) continue;
 
-        char cmd[50], arg1[50], arg2[50];
-        memset(cmd, 0, sizeof(cmd));
-        memset(arg1, 0, sizeof(arg1));
-        memset(arg2, 0, sizeof(arg2));
-        
-        sscanf(line, "%49s %49s %49s", cmd, arg1, arg2);
-        if (strcmp(cmd, "Sleep") == 0) {
-            float sleep_time = atof(arg1);
+        // IMPROVEMENT: Token spans into the line itself (line is reused for
+        // sending, so the non-mutating tokenizer is used here)
+        Token toks[3];
+        int ntok = tokenize(line, toks, 3);
+        if (ntok == 0) continue;
+
+        // Substitute a known session token for the user name on Lend/LendWait
+        // (single-instance only: shards assign ids independently)
+        if (num_shards == 1 &&
+            (token_eq(toks[0], "Lend") || token_eq(toks[0], "LendWait")) &&
+            ntok > 2) {
+            for (int s = 0; s < session_count; s++) {
+                if (token_eq(toks[2], session_names[s])) {
+                    char rewritten[256];
+                    snprintf(rewritten, sizeof(rewritten), "%.*s %.*s #%d",
+                             (int)toks[0].len, toks[0].p,
+                             (int)toks[1].len, toks[1].p, session_tokens[s]);
+                    snprintf(line, sizeof(line), "%s", rewritten);
+                    break;
+                }
+            }
+        }
+
+        if (token_eq(toks[0], "BatchBegin")) {
+            batching = 1;
+            batch_count = 0;
+            batch_len = 0;
+            continue;
+        } else if (batching && !token_eq(toks[0], "BatchEnd")) {
+            // Collect the command; it is sent when the batch closes
+            size_t len = strlen(line);
+            if (batch_len + len + 1 < sizeof(batch_buf)) {
+                memcpy(batch_buf + batch_len, line, len);
+                batch_len += len;
+                batch_buf[batch_len++] = '\n';
+                batch_count++;
+            } else {
+                write_log("CLIENT_ERR", "Batch too large, command dropped");
+            }
+            continue;
+        } else if (token_eq(toks[0], "BatchEnd")) {
+            batching = 0;
+            if (batch_count == 0) continue;
+
+            if (!connected) {
+                sock = library_connect();
+                if (sock < 0) continue;
+                connected = 1;
+            }
+
+            // One send for the whole batch, then read until every response
+            // (one newline-terminated line per command) has arrived
+            send(sock, batch_buf, batch_len, 0);
+
+            char resp_buf[BUFFER_SIZE * 4];
+            int resp_len = 0, newlines = 0;
+            while (newlines < batch_count) {
+                ssize_t n = read(sock, resp_buf + resp_len,
+                                 sizeof(resp_buf) - 1 - resp_len);
+                if (n <= 0) {
+                    write_log("CLIENT_ERR", "Batch response read failed");
+                    break;
+                }
+                for (ssize_t i = 0; i < n; i++) {
+                    if (resp_buf[resp_len + i] == '\n') newlines++;
+                }
+                resp_len += n;
+                if (resp_len >= (int)sizeof(resp_buf) - 1) break;
+            }
+            resp_buf[resp_len] = '\0';
+            for (int i = 0; i < resp_len; i++) {
+                if (resp_buf[i] == '\n') resp_buf[i] = ' ';
+            }
+            snprintf(log_buf, sizeof(log_buf),
+                     "Batch of %d commands | Responses: %.800s",
+                     batch_count, resp_buf);
+            write_log("CLIENT_THREAD", log_buf);
+            continue;
+        }
+        if (token_eq(toks[0], "Sleep")) {
+            // Sleep is a pipeline barrier: settle in-flight commands first
+            if (pending_count > 0 && connected) {
+                drain_pipeline(sock, pending, pending_count,
+                               resp_acc, &resp_acc_len, sizeof(resp_acc));
+                pending_count = 0;
+            }
+            // atof stops at the first non-numeric character, so the span's
+            // start pointer is enough -- no copy needed
+            float sleep_time = (ntok > 1) ? atof(toks[1].p) : 0.0f;
             snprintf(log_buf, sizeof(log_buf), "Sleeping for %.1f seconds", sleep_time);
             write_log("CLIENT_THREAD", log_buf);
             usleep((unsigned int)(sleep_time * 1000000)); // usleep takes microseconds
@@ -88,38 +711,89 @@ void *simulate_user(void *arg) {
             // NETWORK REQUEST
             char buffer[BUFFER_SIZE] = {0};
 
-            // Establish connection if not already connected
-            if (!connected) {
-                sock = socket(AF_INET, SOCK_STREAM, 0);
-                if (sock < 0) {
-                    write_log("CLIENT_ERR", "Socket creation error");
-                    continue;
+            // Sharded routing: the title's hash picks the owning instance.
+            // Register fans out to every shard; Search does too, since the
+            // matching titles are spread across shards by hash, and the
+            // per-shard counts and title lists are merged into one response.
+            // Title-less commands (Stats) go to shard 0.
+            if (num_shards > 1) {
+                if (token_eq(toks[0], "Register")) {
+                    for (int sh = 0; sh < num_shards; sh++) {
+                        if (shard_request(shard_socks, sh, line,
+                                          buffer, sizeof(buffer)) < 0) break;
+                    }
+                } else if (token_eq(toks[0], "Search")) {
+                    // FIX: a prefix's matches hash to arbitrary shards, so
+                    // asking only shard 0 silently dropped the rest; query
+                    // every shard and merge "success <count> <titles...>"
+                    int total = 0;
+                    char merged[BUFFER_SIZE / 2];
+                    size_t merged_len = 0;
+                    for (int sh = 0; sh < num_shards; sh++) {
+                        if (shard_request(shard_socks, sh, line,
+                                          buffer, sizeof(buffer)) < 0) continue;
+                        int count = 0;
+                        if (sscanf(buffer, "success %d", &count) != 1) continue;
+                        total += count;
+                        // The title list starts at the space after the count
+                        char *list = strchr(buffer + 8, ' ');
+                        if (list) {
+                            size_t len = strlen(list);
+                            if (merged_len + len < sizeof(merged)) {
+                                memcpy(merged + merged_len, list, len);
+                                merged_len += len;
+                            }
+                        }
+                    }
+                    merged[merged_len] = '\0';
+                    if (total == 0) {
+                        snprintf(buffer, sizeof(buffer), "failure (no matches)");
+                    } else {
+                        snprintf(buffer, sizeof(buffer), "success %d%s",
+                                 total, merged);
+                    }
+                } else {
+                    int sh = 0;
+                    if (ntok > 1) {
+                        sh = (int)(shard_hash(toks[1].p, toks[1].len)
+                                   % (unsigned long)num_shards);
+                    }
+                    shard_request(shard_socks, sh, line,
+                                  buffer, sizeof(buffer));
                 }
+                snprintf(log_buf, sizeof(log_buf),
+                         "Command: %s | Response: %s", line, buffer);
+                write_log("CLIENT_THREAD", log_buf);
+                continue;
+            }
 
-                struct sockaddr_in serv_addr;
-                serv_addr.sin_family = AF_INET;
-                serv_addr.sin_port = htons(PORT);
-                
-                if (inet_pton(AF_INET, "127.0.0.1", &serv_addr.sin_addr) <= 0) {
-                    write_log("CLIENT_ERR", "Invalid address conversion");
-                    close(sock);
-                    sock = -1;
-                    continue;
+            // Shared-memory fast path when co-located with the library
+            if (!shm_tried) {
+                shm_tried = 1;
+                shm_ch = shm_channel_claim();
+                if (shm_ch) {
+                    write_log("CLIENT_THREAD", "Using shared-memory transport");
                 }
-
-                // Try to connect with retries
-                int retry_count = 0;
-                while (connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
-                    retry_count++;
-                    if (retry_count > 5) {
-                        write_log("CLIENT_ERR", "Connection failed after retries");
-                        close(sock);
-                        sock = -1;
-                        break;
-                    }
-                    usleep(100000); // Wait 100ms before retry
+            }
+            if (shm_ch) {
+                shm_channel_request(shm_ch, line, buffer, sizeof(buffer));
+                if (token_eq(toks[0], "Register") && ntok > 1 &&
+                    strncmp(buffer, "success ", 8) == 0 &&
+                    session_count < MAX_SESSIONS) {
+                    snprintf(session_names[session_count],
+                             sizeof(session_names[0]), "%.*s",
+                             (int)toks[1].len, toks[1].p);
+                    session_tokens[session_count++] = atoi(buffer + 8);
                 }
+                snprintf(log_buf, sizeof(log_buf),
+                         "Command: %s | Response: %s", line, buffer);
+                write_log("CLIENT_THREAD", log_buf);
+                continue;
+            }
 
+            // Establish connection if not already connected
+            if (!connected) {
+                sock = library_connect();
                 if (sock >= 0) {
                     connected = 1;
                     char conn_msg[256];
@@ -130,12 +804,62 @@ void *simulate_user(void *arg) {
 
             if (connected && sock >= 0) {
                 // Send Command on persistent connection
-                send(sock, line, strlen(line), 0);
-                
+                // IMPROVEMENT: Newline-delimited framing, matching the
+                // server's keep-alive request loop
+                char request[BUFFER_SIZE];
+                snprintf(request, sizeof(request), "%s\n", line);
+                send(sock, request, strlen(request), 0);
+
+                if (pipeline > 1) {
+                    // Pipelined: record the in-flight command and only stop
+                    // to read once the window is full
+                    snprintf(pending[pending_count], sizeof(pending[0]),
+                             "%s", line);
+                    pending_count++;
+                    if (pending_count >= pipeline) {
+                        drain_pipeline(sock, pending, pending_count,
+                                       resp_acc, &resp_acc_len,
+                                       sizeof(resp_acc));
+                        pending_count = 0;
+                    }
+                    continue;
+                }
+
                 memset(buffer, 0, sizeof(buffer));
                 ssize_t bytes_read = read(sock, buffer, BUFFER_SIZE - 1);
                 if (bytes_read > 0) {
                     buffer[bytes_read] = '\0';
+                    buffer[strcspn(buffer, "\n")] = 0; // Strip response terminator
+                    // Backpressure: the server shed this connection because
+                    // its pending queue was full. Back off briefly,
+                    // reconnect and retry the command once.
+                    if (strncmp(buffer, "failure (server busy", 20) == 0) {
+                        write_log("CLIENT_THREAD",
+                                  "Server busy, retrying after backoff");
+                        close(sock);
+                        connected = 0;
+                        usleep(100000);
+                        sock = library_connect();
+                        if (sock >= 0) {
+                            connected = 1;
+                            send(sock, request, strlen(request), 0);
+                            memset(buffer, 0, sizeof(buffer));
+                            bytes_read = read(sock, buffer, BUFFER_SIZE - 1);
+                            if (bytes_read > 0) {
+                                buffer[bytes_read] = '\0';
+                                buffer[strcspn(buffer, "\n")] = 0;
+                            }
+                        }
+                    }
+                    // Remember the id a successful Register handed back
+                    if (token_eq(toks[0], "Register") && ntok > 1 &&
+                        strncmp(buffer, "success ", 8) == 0 &&
+                        session_count < MAX_SESSIONS) {
+                        snprintf(session_names[session_count],
+                                 sizeof(session_names[0]), "%.*s",
+                                 (int)toks[1].len, toks[1].p);
+                        session_tokens[session_count++] = atoi(buffer + 8);
+                    }
                     snprintf(log_buf, sizeof(log_buf), "Command: %s | Response: %s", line, buffer);
                     write_log("CLIENT_THREAD", log_buf);
                 } else if (bytes_read == 0) {
@@ -151,6 +875,24 @@ void *simulate_user(void *arg) {
         }
     }
 
+    // Settle any commands still in flight before closing
+    if (pending_count > 0 && connected && sock >= 0) {
+        drain_pipeline(sock, pending, pending_count,
+                       resp_acc, &resp_acc_len, sizeof(resp_acc));
+        pending_count = 0;
+    }
+
+    // Close the per-shard connections
+    for (int i = 0; i < MAX_SHARDS; i++) {
+        if (shard_socks[i] >= 0) close(shard_socks[i]);
+    }
+
+    // Hand the shared-memory channel back for the next client thread
+    if (shm_ch) {
+        shm_channel_release(shm_ch);
+        write_log("CLIENT_THREAD", "Shared-memory channel released");
+    }
+
     // Close persistent connection when done
     if (connected && sock >= 0) {
         close(sock);
@@ -1,61 +1,730 @@
 // library.c
 #include "common.h"
 #include <signal.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <time.h>
 
 // --- Data Structures ---
-#define MAX_USERS 100
-#define MAX_BOOKS 100
+// IMPROVEMENT: The old fixed User[100]/Book[100] arrays are gone. Tables and
+// string arenas are large virtual reservations (MAP_NORESERVE) committed one
+// page at a time as entries are added, so memory scales with actual data,
+// titles/names are variable length and cache-packed, and the base pointers
+// never move (the lock-free Lend/Return path can safely cache them).
+#define MAX_USERS (1 << 20)
+#define MAX_BOOKS (1 << 22)
+#define TITLE_ARENA_RESERVE ((size_t)256 << 20)
+#define NAME_ARENA_RESERVE ((size_t)64 << 20)
+
+// IMPROVEMENT: Worker pool (no per-request pthread_create/malloc)
+#define DEFAULT_WORKERS 4
+#define SOCKET_QUEUE_SIZE 128
+
+// IMPROVEMENT: Backpressure (LIBRARY_BACKLOG=N). The kernel accept queue
+// used to be a hardcoded 5, so connection bursts died with RST before the
+// server ever saw them
+#define DEFAULT_LISTEN_BACKLOG 128
+
+// IMPROVEMENT: Epoll reactor mode (LIBRARY_EPOLL=1)
+#define DEFAULT_IO_THREADS 2
+#define MAX_IO_THREADS 16
+#define MAX_EPOLL_EVENTS 64
+
+// IMPROVEMENT: Multi-acceptor mode (LIBRARY_ACCEPTORS=N, SO_REUSEPORT)
+#define MAX_ACCEPTORS 16
+
+// Set by reactor I/O threads. They multiplex many connections, so request
+// handlers that park (LendWait) must refuse on these threads instead of
+// stalling every connection behind the sleeping one.
+static _Thread_local int on_reactor_thread = 0;
 
 // Signal handler for graceful shutdown
 volatile sig_atomic_t keep_running = 1;
 
+// Listen port, overridable with LIBRARY_PORT (sharded deployments run N
+// instances on consecutive ports)
+int listen_port = PORT;
+
+// Sharded deployment (LIBRARY_SHARDS=N): this instance's position in the
+// title-hash ring, derived from its port offset. Preloading filters on it so
+// each instance only carries the titles it owns.
+int shard_count = 1;
+int shard_index = 0;
+
+// Does this instance own the given title's hash slot? Always true when
+// running unsharded.
+int title_owned_here(const char *title) {
+    if (shard_count <= 1) return 1;
+    return (int)(shard_hash(title, strlen(title))
+                 % (unsigned long)shard_count) == shard_index;
+}
+
 void handle_sigterm(int sig) {
     (void)sig; // Avoid unused parameter warning
     keep_running = 0;
 }
 
 typedef struct {
-    char name[50];
+    uint32_t name_off; // Offset into name_arena
     int id;
 } User;
 
 typedef struct {
-    char title[50];
-    int available; // 1 = Yes, 0 = No
+    uint32_t title_off; // Offset into title_arena
+    // IMPROVEMENT: Atomic so Lend/Return are a single compare-and-swap with
+    // no lock acquisition. 1 = Yes, 0 = No
+    atomic_int available;
 } Book;
 
-// Global Tables
-User users[MAX_USERS];
+// Global Tables (mmap'd reservations, see storage_init)
+User *users = NULL;
 int user_count = 0;
-Book books[MAX_BOOKS];
+Book *books = NULL;
 int book_count = 0;
 
+// String arenas: variable-length NUL-terminated titles/names, append-only
+char *title_arena = NULL;
+size_t title_arena_used = 0;
+char *name_arena = NULL;
+size_t name_arena_used = 0;
+
+// Book indexes ordered by title (see the sorted title index section)
+int *title_sorted = NULL;
+
+// Columnar availability mirror, one bit per book (see the bulk scan section)
+atomic_ulong *avail_bitmap = NULL;
+
 // READ-WRITE LOCKS
 pthread_rwlock_t user_lock;
 pthread_rwlock_t book_lock;
 
-// --- Helper: Find Book Index ---
-int find_book_index(char *title) {
-    for (int i = 0; i < book_count; i++) {
-        if (strcmp(books[i].title, title) == 0) return i;
+// IMPROVEMENT: Striped locking for book state. book_lock now only guards
+// structure (books[]/book_count/book_hash growth). The Lend/Return fast
+// path has since moved to a CAS on the atomic available flag and takes no
+// lock at all; the shard locks coordinate the LendWait waitlists, where a
+// single flag update is not enough.
+#define NUM_BOOK_SHARDS 16
+pthread_mutex_t book_shard_locks[NUM_BOOK_SHARDS];
+
+// IMPROVEMENT: LendWait waitlists. A LendWait on a lent title parks the
+// handler on its shard's condition variable instead of making the client
+// poll with repeated Lends; Return broadcasts the shard so parked waiters
+// re-try their CAS, and a deadline bounds the wait.
+pthread_cond_t book_shard_conds[NUM_BOOK_SHARDS];
+#define LENDWAIT_TIMEOUT_SEC 5
+
+// --- Arena / Table Storage ---
+// Reserve address space without committing pages; the kernel backs pages as
+// they are first touched
+void *reserve_region(size_t bytes) {
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("Storage reservation failed");
+        exit(1);
+    }
+    return p;
+}
+
+// Append a NUL-terminated string to an arena, returning its offset
+// (UINT32_MAX if the arena reservation is exhausted)
+uint32_t arena_add(char *arena, size_t *used, size_t reserve, const char *s) {
+    size_t len = strlen(s) + 1;
+    if (*used + len > reserve) return UINT32_MAX;
+    memcpy(arena + *used, s, len);
+    uint32_t off = (uint32_t)*used;
+    *used += len;
+    return off;
+}
+
+const char *book_title(int idx) { return title_arena + books[idx].title_off; }
+const char *user_name(int idx)  { return name_arena + users[idx].name_off; }
+
+// --- RCU-style Catalog Snapshots ---
+// IMPROVEMENT: Readers of the catalog never take a lock. Because books[] and
+// the title arena are append-only and their base pointers never move, an
+// immutable snapshot is fully described by how many entries were published:
+// entries [0, count) can never change under a reader (only the atomic
+// available flag, which readers load atomically anyway). Publication is a
+// single 64-bit atomic store of (version << 32 | count) after AddBook, so
+// there is no copied state and nothing to reclaim.
+atomic_uint_fast64_t catalog_version = 0;
+
+// Publish the current book_count as a new catalog version.
+// Caller holds book_lock exclusively, so publishers are serialized.
+void catalog_publish(void) {
+    uint64_t v = atomic_load(&catalog_version);
+    atomic_store(&catalog_version,
+                 (((v >> 32) + 1) << 32) | (uint32_t)book_count);
+}
+
+// Lock-free reader entry point: a consistent count (and version, if asked)
+int catalog_snapshot(uint64_t *version_out) {
+    uint64_t v = atomic_load(&catalog_version);
+    if (version_out) *version_out = v >> 32;
+    return (int)(uint32_t)v;
+}
+
+// --- Bulk Scan Engine (columnar availability bitmap) ---
+// IMPROVEMENT: A full-catalog availability report used to mean touching one
+// cache line per book. The availability flags are mirrored into a packed
+// bitmap -- 64 titles per word -- kept in sync by the same operations that
+// flip the per-book flag, so a Report is a popcount sweep over count/64
+// words: data-parallel in 64-bit lanes with the popcnt instruction doing
+// the per-word tally. Combined with a catalog_snapshot() count it runs
+// entirely lock-free and never stalls Lend/Return.
+void avail_bit_set(int idx) {
+    atomic_fetch_or(&avail_bitmap[idx >> 6], 1ul << (idx & 63));
+}
+
+void avail_bit_clear(int idx) {
+    atomic_fetch_and(&avail_bitmap[idx >> 6], ~(1ul << (idx & 63)));
+}
+
+// Count available titles among the first `count` published entries
+long avail_bitmap_count(int count) {
+    long available = 0;
+    int full_words = count >> 6;
+    for (int w = 0; w < full_words; w++) {
+        available += __builtin_popcountll(
+            atomic_load_explicit(&avail_bitmap[w], memory_order_relaxed));
+    }
+    if (count & 63) {
+        unsigned long mask = (1ul << (count & 63)) - 1;
+        available += __builtin_popcountll(
+            atomic_load_explicit(&avail_bitmap[full_words],
+                                 memory_order_relaxed) & mask);
+    }
+    return available;
+}
+
+// --- Hash Indexes ---
+// IMPROVEMENT: O(1) title->index and name->index lookups (open addressing,
+// linear probing) instead of strcmp scans under the table locks. Slots hold
+// an index into books[]/users[], or -1 when empty. Tables start small and
+// double whenever load reaches 50% so probe chains stay short at any size.
+#define HASH_INITIAL_SIZE 1024
+
+int *book_hash = NULL;
+size_t book_hash_cap = 0;
+int *user_hash = NULL;
+size_t user_hash_cap = 0;
+
+// djb2 string hash
+unsigned long hash_string(const char *s) {
+    unsigned long h = 5381;
+    while (*s) h = ((h << 5) + h) + (unsigned char)*s++;
+    return h;
+}
+
+int *hash_table_alloc(size_t cap) {
+    int *table = malloc(cap * sizeof(int));
+    if (!table) {
+        perror("Hash table allocation failed");
+        exit(1);
+    }
+    for (size_t i = 0; i < cap; i++) table[i] = -1;
+    return table;
+}
+
+void hash_index_init(void) {
+    book_hash_cap = HASH_INITIAL_SIZE;
+    book_hash = hash_table_alloc(book_hash_cap);
+    user_hash_cap = HASH_INITIAL_SIZE;
+    user_hash = hash_table_alloc(user_hash_cap);
+}
+
+// Allocate the tables and arenas (single-threaded startup)
+void storage_init(void) {
+    books = reserve_region((size_t)MAX_BOOKS * sizeof(Book));
+    users = reserve_region((size_t)MAX_USERS * sizeof(User));
+    title_sorted = reserve_region((size_t)MAX_BOOKS * sizeof(int));
+    avail_bitmap = reserve_region((size_t)MAX_BOOKS / 8);
+    title_arena = reserve_region(TITLE_ARENA_RESERVE);
+    name_arena = reserve_region(NAME_ARENA_RESERVE);
+    hash_index_init();
+}
+
+// Shard owning a title's availability state
+int book_shard(const char *title) {
+    return hash_string(title) % NUM_BOOK_SHARDS;
+}
+
+// --- Helper: Find Book Index (O(1) hash lookup) ---
+int find_book_index(const char *title) {
+    unsigned long h = hash_string(title) & (book_hash_cap - 1);
+    while (book_hash[h] != -1) {
+        if (strcmp(book_title(book_hash[h]), title) == 0) return book_hash[h];
+        h = (h + 1) & (book_hash_cap - 1);
     }
     return -1;
 }
 
-// --- Helper: Find User by Name ---
-int find_user_by_name(char *name) {
-    for (int i = 0; i < user_count; i++) {
-        if (strcmp(users[i].name, name) == 0) return i;
+// --- Helper: Find User by Name (O(1) hash lookup) ---
+int find_user_by_name(const char *name) {
+    unsigned long h = hash_string(name) & (user_hash_cap - 1);
+    while (user_hash[h] != -1) {
+        if (strcmp(user_name(user_hash[h]), name) == 0) return user_hash[h];
+        h = (h + 1) & (user_hash_cap - 1);
     }
     return -1;
 }
 
+// Double a hash table and reinsert every live index. Caller must hold the
+// matching write lock.
+void hash_table_grow(int **table, size_t *cap, const char *(*key_of)(int)) {
+    size_t new_cap = *cap * 2;
+    int *new_table = hash_table_alloc(new_cap);
+    for (size_t i = 0; i < *cap; i++) {
+        int idx = (*table)[i];
+        if (idx == -1) continue;
+        unsigned long h = hash_string(key_of(idx)) & (new_cap - 1);
+        while (new_table[h] != -1) h = (h + 1) & (new_cap - 1);
+        new_table[h] = idx;
+    }
+    free(*table);
+    *table = new_table;
+    *cap = new_cap;
+}
+
+// Caller must hold the matching write lock (or be in single-threaded startup)
+void book_hash_insert(int idx) {
+    if ((size_t)(book_count + 1) * 2 > book_hash_cap) {
+        hash_table_grow(&book_hash, &book_hash_cap, book_title);
+    }
+    unsigned long h = hash_string(book_title(idx)) & (book_hash_cap - 1);
+    while (book_hash[h] != -1) h = (h + 1) & (book_hash_cap - 1);
+    book_hash[h] = idx;
+}
+
+void user_hash_insert(int idx) {
+    if ((size_t)(user_count + 1) * 2 > user_hash_cap) {
+        hash_table_grow(&user_hash, &user_hash_cap, user_name);
+    }
+    unsigned long h = hash_string(user_name(idx)) & (user_hash_cap - 1);
+    while (user_hash[h] != -1) h = (h + 1) & (user_hash_cap - 1);
+    user_hash[h] = idx;
+}
+
+// --- Sorted Title Index ---
+// IMPROVEMENT: Backs the Search command. book indexes ordered by title so a
+// prefix search is a binary search for the range start plus a walk over the
+// matching run, instead of an O(n) strcmp scan of the whole catalog.
+// Maintained under book_lock on AddBook; searched under a read lock.
+
+// First position whose title is >= key (binary search)
+int title_sorted_lower_bound(const char *key) {
+    int lo = 0, hi = book_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (strcmp(book_title(title_sorted[mid]), key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// Insert a new book index at its sorted position (caller holds book_lock).
+// Note: book_count has not been incremented for idx yet.
+void title_sorted_insert(int idx) {
+    int pos = title_sorted_lower_bound(book_title(idx));
+    memmove(title_sorted + pos + 1, title_sorted + pos,
+            (size_t)(book_count - pos) * sizeof(int));
+    title_sorted[pos] = idx;
+}
+
+// --- Helper: Append a book and index it (caller holds book_lock) ---
+int add_book_entry(const char *title) {
+    if (book_count >= MAX_BOOKS) return -1;
+    uint32_t off = arena_add(title_arena, &title_arena_used,
+                             TITLE_ARENA_RESERVE, title);
+    if (off == UINT32_MAX) return -1;
+    books[book_count].title_off = off;
+    books[book_count].available = 1;
+    avail_bit_set(book_count);
+    book_hash_insert(book_count);
+    title_sorted_insert(book_count);
+    book_count++;
+    catalog_publish(); // Make the new entry visible to lock-free readers
+    return book_count - 1;
+}
+
+// --- Helper: Append a user and index it (caller holds user_lock) ---
+// Returns the new user id, or -1 when full
+int add_user_entry(const char *name) {
+    if (user_count >= MAX_USERS) return -1;
+    uint32_t off = arena_add(name_arena, &name_arena_used,
+                             NAME_ARENA_RESERVE, name);
+    if (off == UINT32_MAX) return -1;
+    users[user_count].name_off = off;
+    users[user_count].id = user_count + 1;
+    user_hash_insert(user_count);
+    user_count++;
+    return user_count;
+}
+
+// --- Performance Counters ---
+// IMPROVEMENT: Per-command counters (requests, failures, handler latency,
+// lock-wait time) kept in cache-line-aligned slots indexed per thread, so
+// hot-path increments do not bounce one shared line between cores. The Stats
+// command aggregates all slots on demand.
+#define NUM_CMD_STATS 9
+#define NUM_STAT_SLOTS 16
+
+const char *cmd_stat_names[NUM_CMD_STATS] = {
+    "Register", "Lend", "LendWait", "Return", "AddBook", "Query", "Search",
+    "Report", "Other"
+};
+
+typedef struct {
+    atomic_ulong requests[NUM_CMD_STATS];
+    atomic_ulong failures[NUM_CMD_STATS];
+    atomic_ulong latency_ns[NUM_CMD_STATS];
+    atomic_ulong lock_wait_ns;
+} __attribute__((aligned(64))) StatSlot;
+
+StatSlot stat_slots[NUM_STAT_SLOTS];
+
+// Connections shed with a busy response because the pending queue was full
+// (reported by Stats)
+atomic_ulong busy_rejects = 0;
+
+// Each thread claims a slot on first use; with more threads than slots the
+// counters stay correct (atomic), just with some sharing
+static _Thread_local int my_stat_slot = -1;
+atomic_int stat_slot_next = 0;
+
+StatSlot *stat_slot(void) {
+    if (my_stat_slot < 0) {
+        my_stat_slot = atomic_fetch_add(&stat_slot_next, 1) % NUM_STAT_SLOTS;
+    }
+    return &stat_slots[my_stat_slot];
+}
+
+uint64_t stat_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int cmd_stat_index(const char *command) {
+    for (int i = 0; i < NUM_CMD_STATS - 1; i++) {
+        if (strcmp(command, cmd_stat_names[i]) == 0) return i;
+    }
+    return NUM_CMD_STATS - 1; // "Other"
+}
+
+// Lock wrappers that attribute acquisition wait time to the caller's slot
+void stat_rdlock(pthread_rwlock_t *lock) {
+    uint64_t t0 = stat_now_ns();
+    pthread_rwlock_rdlock(lock);
+    atomic_fetch_add(&stat_slot()->lock_wait_ns, stat_now_ns() - t0);
+}
+
+void stat_wrlock(pthread_rwlock_t *lock) {
+    uint64_t t0 = stat_now_ns();
+    pthread_rwlock_wrlock(lock);
+    atomic_fetch_add(&stat_slot()->lock_wait_ns, stat_now_ns() - t0);
+}
+
+// qsort comparator ordering book indexes by title
+int cmp_title_index(const void *a, const void *b) {
+    return strcmp(book_title(*(const int*)a), book_title(*(const int*)b));
+}
+
+// --- Binary Snapshot Persistence ---
+// IMPROVEMENT: On SIGTERM the tables are dumped as fixed-size records; at
+// startup the snapshot is mmap'd and restored with one bulk copy instead of
+// reparsing books.conf line by line, so recovery cost is independent of how
+// the catalog was built (and registered users survive restarts).
+#define SNAPSHOT_MAGIC 0x4C49425Bu // "[BIL" on disk
+#define SNAPSHOT_VERSION 2 // v2: variable-length strings live in the arenas
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t book_count;
+    int32_t user_count;
+    uint64_t title_arena_used;
+    uint64_t name_arena_used;
+} SnapshotHeader;
+
+// Sharded instances (LIBRARY_PORT != PORT) get port-suffixed paths so N
+// instances in one directory do not clobber each other's state
+char snapshot_path[64] = SNAPSHOT_FILE;
+char journal_path[64] = JOURNAL_FILE;
+
+void save_snapshot(void) {
+    int fd = open(snapshot_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        write_log("LIBRARY", "Warning: could not write snapshot");
+        return;
+    }
+
+    SnapshotHeader hdr = { SNAPSHOT_MAGIC, SNAPSHOT_VERSION, book_count,
+                           user_count, title_arena_used, name_arena_used };
+    write(fd, &hdr, sizeof(hdr));
+    write(fd, books, (size_t)book_count * sizeof(Book));
+    write(fd, users, (size_t)user_count * sizeof(User));
+    write(fd, title_arena, title_arena_used);
+    write(fd, name_arena, name_arena_used);
+    close(fd);
+
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Snapshot saved: %d books, %d users",
+             book_count, user_count);
+    write_log("LIBRARY", log_msg);
+}
+
+// Returns number of books restored, 0 if no usable snapshot exists
+int load_snapshot(void) {
+    int fd = open(snapshot_path, O_RDONLY);
+    if (fd == -1) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return 0;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return 0;
+
+    SnapshotHeader *hdr = (SnapshotHeader*)map;
+    size_t expected = sizeof(SnapshotHeader)
+                    + (size_t)hdr->book_count * sizeof(Book)
+                    + (size_t)hdr->user_count * sizeof(User)
+                    + hdr->title_arena_used + hdr->name_arena_used;
+    if (hdr->magic != SNAPSHOT_MAGIC || hdr->version != SNAPSHOT_VERSION ||
+        hdr->book_count < 0 || hdr->book_count > MAX_BOOKS ||
+        hdr->user_count < 0 || hdr->user_count > MAX_USERS ||
+        hdr->title_arena_used > TITLE_ARENA_RESERVE ||
+        hdr->name_arena_used > NAME_ARENA_RESERVE ||
+        (size_t)st.st_size < expected) {
+        write_log("LIBRARY", "Warning: ignoring malformed snapshot");
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    // Records match the in-memory struct layout: bulk copies, no parsing
+    char *records = (char*)map + sizeof(SnapshotHeader);
+    memcpy(books, records, (size_t)hdr->book_count * sizeof(Book));
+    records += (size_t)hdr->book_count * sizeof(Book);
+    memcpy(users, records, (size_t)hdr->user_count * sizeof(User));
+    records += (size_t)hdr->user_count * sizeof(User);
+    memcpy(title_arena, records, hdr->title_arena_used);
+    records += hdr->title_arena_used;
+    memcpy(name_arena, records, hdr->name_arena_used);
+    book_count = hdr->book_count;
+    user_count = hdr->user_count;
+    title_arena_used = hdr->title_arena_used;
+    name_arena_used = hdr->name_arena_used;
+    munmap(map, st.st_size);
+    catalog_publish(); // Expose the restored entries to lock-free readers
+
+    // Rebuild the hash, sorted and bitmap indexes over the restored records
+    for (int i = 0; i < book_count; i++) {
+        book_hash_insert(i);
+        if (atomic_load(&books[i].available)) avail_bit_set(i);
+    }
+    for (int i = 0; i < user_count; i++) user_hash_insert(i);
+    for (int i = 0; i < book_count; i++) title_sorted[i] = i;
+    qsort(title_sorted, book_count, sizeof(int), cmp_title_index);
+
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg), "Snapshot restored: %d books, %d users",
+             book_count, user_count);
+    write_log("LIBRARY", log_msg);
+    return book_count;
+}
+
+// --- Operation Journal (group commit) ---
+// IMPROVEMENT: Durability without an fsync per operation (LIBRARY_JOURNAL=1).
+// Mutating handlers append a small binary record to an in-memory buffer and
+// block until a committer thread has flushed the whole group with a single
+// write+fsync, so the per-operation durability cost is one fsync divided by
+// the batch size. On startup the journal is replayed on top of the snapshot;
+// it is truncated whenever a fresh snapshot makes it redundant.
+#define JOURNAL_BUF_SIZE (64 * 1024)
+
+#define JOP_REGISTER 'U'
+#define JOP_LEND     'L'
+#define JOP_RETURN   'R'
+#define JOP_ADDBOOK  'B'
+
+int journal_enabled = 0;
+int journal_fd = -1;
+int journal_stopping = 0;
+pthread_t journal_thread;
+pthread_mutex_t journal_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t journal_not_empty = PTHREAD_COND_INITIALIZER;
+pthread_cond_t journal_committed = PTHREAD_COND_INITIALIZER;
+
+char journal_buf[JOURNAL_BUF_SIZE];
+size_t journal_buf_len = 0;
+uint64_t journal_buf_gen = 0; // Generation currently accumulating
+uint64_t journal_durable_gen = 0; // Generations below this are on disk
+
+// Append one record and wait until the group containing it is durable
+void journal_append(char op, const char *arg1, const char *arg2) {
+    if (!journal_enabled) return;
+
+    size_t len1 = strlen(arg1);
+    size_t len2 = arg2 ? strlen(arg2) : 0;
+    if (len1 > 255) len1 = 255;
+    if (len2 > 255) len2 = 255;
+    size_t rec_len = 3 + len1 + len2;
+
+    pthread_mutex_lock(&journal_mutex);
+    while (journal_buf_len + rec_len > JOURNAL_BUF_SIZE) {
+        // Buffer full: wait for the committer to drain a group
+        pthread_cond_wait(&journal_committed, &journal_mutex);
+    }
+    char *p = journal_buf + journal_buf_len;
+    p[0] = op;
+    p[1] = (char)len1;
+    p[2] = (char)len2;
+    memcpy(p + 3, arg1, len1);
+    if (len2) memcpy(p + 3 + len1, arg2, len2);
+    journal_buf_len += rec_len;
+
+    uint64_t my_gen = journal_buf_gen;
+    pthread_cond_signal(&journal_not_empty);
+    // Group commit: block until this buffer generation has been fsync'd
+    while (journal_durable_gen <= my_gen) {
+        pthread_cond_wait(&journal_committed, &journal_mutex);
+    }
+    pthread_mutex_unlock(&journal_mutex);
+}
+
+void *journal_committer_main(void *arg) {
+    (void)arg;
+    char writebuf[JOURNAL_BUF_SIZE];
+    for (;;) {
+        pthread_mutex_lock(&journal_mutex);
+        while (journal_buf_len == 0 && !journal_stopping) {
+            pthread_cond_wait(&journal_not_empty, &journal_mutex);
+        }
+        if (journal_buf_len == 0 && journal_stopping) {
+            pthread_mutex_unlock(&journal_mutex);
+            break;
+        }
+
+        // Swap the accumulation buffer out and commit it as one group
+        size_t write_len = journal_buf_len;
+        memcpy(writebuf, journal_buf, write_len);
+        journal_buf_len = 0;
+        uint64_t gen = journal_buf_gen++;
+        pthread_mutex_unlock(&journal_mutex);
+
+        write(journal_fd, writebuf, write_len);
+        fsync(journal_fd); // One fsync for the whole group
+
+        pthread_mutex_lock(&journal_mutex);
+        journal_durable_gen = gen + 1;
+        pthread_cond_broadcast(&journal_committed);
+        pthread_mutex_unlock(&journal_mutex);
+    }
+    return NULL;
+}
+
+// Re-apply journaled operations on top of the loaded snapshot
+void journal_replay(void) {
+    int fd = open(journal_path, O_RDONLY);
+    if (fd == -1) return;
+
+    int replayed = 0;
+    char hdr[3], arg1[256], arg2[256];
+    while (read(fd, hdr, 3) == 3) {
+        size_t len1 = (unsigned char)hdr[1];
+        size_t len2 = (unsigned char)hdr[2];
+        if (read(fd, arg1, len1) != (ssize_t)len1) break;
+        if (read(fd, arg2, len2) != (ssize_t)len2) break;
+        arg1[len1] = '\0';
+        arg2[len2] = '\0';
+
+        switch (hdr[0]) {
+            case JOP_REGISTER:
+                if (find_user_by_name(arg1) == -1) add_user_entry(arg1);
+                break;
+            case JOP_ADDBOOK:
+                if (find_book_index(arg1) == -1) add_book_entry(arg1);
+                break;
+            case JOP_LEND: {
+                int idx = find_book_index(arg1);
+                if (idx != -1) {
+                    atomic_store(&books[idx].available, 0);
+                    avail_bit_clear(idx);
+                }
+                break;
+            }
+            case JOP_RETURN: {
+                int idx = find_book_index(arg1);
+                if (idx != -1) {
+                    atomic_store(&books[idx].available, 1);
+                    avail_bit_set(idx);
+                }
+                break;
+            }
+            default:
+                break; // Unknown record, skip
+        }
+        replayed++;
+    }
+    close(fd);
+
+    if (replayed > 0) {
+        char log_msg[256];
+        snprintf(log_msg, sizeof(log_msg), "Journal replayed: %d operations", replayed);
+        write_log("LIBRARY", log_msg);
+    }
+}
+
+// Replay any existing journal and start the committer (single-threaded startup)
+void journal_init(void) {
+    char *env = getenv("LIBRARY_JOURNAL");
+    if (!env || atoi(env) != 1) return;
+
+    journal_replay();
+
+    journal_fd = open(journal_path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (journal_fd == -1) {
+        write_log("LIBRARY", "Warning: could not open journal, running volatile");
+        return;
+    }
+    if (pthread_create(&journal_thread, NULL, journal_committer_main, NULL) != 0) {
+        close(journal_fd);
+        journal_fd = -1;
+        return;
+    }
+    journal_enabled = 1;
+    write_log("LIBRARY", "Journal enabled (group commit)");
+}
+
+// Stop the committer; call only after all handler threads have exited
+void journal_shutdown(void) {
+    if (!journal_enabled) return;
+    pthread_mutex_lock(&journal_mutex);
+    journal_stopping = 1;
+    pthread_cond_broadcast(&journal_not_empty);
+    pthread_mutex_unlock(&journal_mutex);
+    pthread_join(journal_thread, NULL);
+    // The snapshot saved at shutdown covers everything journaled so far
+    ftruncate(journal_fd, 0);
+    close(journal_fd);
+    journal_enabled = 0;
+}
+
 // --- Helper: Load books from config file ---
 int load_books_from_file(const char *books_file) {
     FILE *fp = fopen(books_file, "r");
     if (!fp) {
         write_log("LIBRARY", "Warning: Could not open books.conf, using defaults");
-        return 0;
+        return -1;
     }
 
     char line[256];
@@ -67,232 +736,1072 @@ int load_books_from_file(const char *books_file) {
         // Skip empty lines
         if (strlen(line) == 0) continue;
 
-        strncpy(books[book_count].title, line, 49);
-        books[book_count].title[49] = '\0';
-        books[book_count].available = 1;
-        book_count++;
+        // FIX: Sharded instances each parse the full config, so without this
+        // filter every shard carried every preloaded title and cross-shard
+        // Search merges returned duplicates
+        if (!title_owned_here(line)) continue;
+
+        add_book_entry(line);
     }
 
     fclose(fp);
-    
+
     char log_msg[256];
     snprintf(log_msg, sizeof(log_msg), "Loaded %d books from %s", book_count, books_file);
     write_log("LIBRARY", log_msg);
-    
+
     return book_count;
 }
 
-// --- Handler Thread ---
-void *client_handler(void *socket_desc) {
-    int sock = *(int*)socket_desc;
-    free(socket_desc);
-    char buffer[BUFFER_SIZE] = {0};
-    char response[BUFFER_SIZE] = {0};
-
-    // Read Request
-    ssize_t bytes_read = read(sock, buffer, BUFFER_SIZE - 1);
-    if (bytes_read < 0) {
-        perror("Read error");
-        close(sock);
-        return NULL;
+// Resolve a Lend/LendWait user argument: a "#<id>" session token needs only
+// a bounds check (users are append-only with stable ids), a plain name goes
+// through the locked hash lookup
+int lend_user_exists(const char *arg) {
+    if (arg[0] == '#') {
+        int token = atoi(arg + 1);
+        return token >= 1 && token <= user_count;
     }
-    buffer[bytes_read] = '\0';
-    
-    char command[50], arg1[50], arg2[50];
-    memset(arg1, 0, sizeof(arg1));
-    memset(arg2, 0, sizeof(arg2));
-    // FIX: Use width specifiers to prevent buffer overflow
-    sscanf(buffer, "%49s %49s %49s", command, arg1, arg2);
+    stat_rdlock(&user_lock);
+    int exists = (find_user_by_name(arg) != -1);
+    pthread_rwlock_unlock(&user_lock);
+    return exists;
+}
+
+// --- Process one request line, fill in the response ---
+void process_command(char *buffer, char *response) {
+    uint64_t stat_t0 = stat_now_ns();
 
     char log_msg[BUFFER_SIZE];
-    snprintf(log_msg, sizeof(log_msg), "Request received: %s", buffer);
-    write_log("LIBRARY_THREAD", log_msg);
+    // IMPROVEMENT: With LOG_BINARY=1 the request/response trace is emitted
+    // as compact binary event records (no snprintf on the hot path); the
+    // logdump tool renders them to text offline
+    if (event_log_active()) {
+        log_event(COMP_LIBRARY, EV_REQUEST, buffer);
+    } else {
+        snprintf(log_msg, sizeof(log_msg), "Request received: %s", buffer);
+        write_log("LIBRARY_THREAD", log_msg);
+    }
+
+    // IMPROVEMENT: Tokenize the request in place (we own the buffer) instead
+    // of sscanf-copying into fixed 50-byte stack buffers
+    static char empty[] = "";
+    char *tokens[3];
+    int ntok = tokenize_inplace(buffer, tokens, 3);
+    char *command = (ntok > 0) ? tokens[0] : empty;
+    char *arg1    = (ntok > 1) ? tokens[1] : empty;
+    char *arg2    = (ntok > 2) ? tokens[2] : empty;
 
     // --- LOGIC: REGISTER (Write Lock Users) ---
     if (strcmp(command, "Register") == 0) {
-        pthread_rwlock_wrlock(&user_lock); // Exclusive Lock
+        stat_wrlock(&user_lock); // Exclusive Lock
         
-        // FIX: Check if library is at capacity
-        if (user_count >= MAX_USERS) {
-            strcpy(response, "failure (max users reached)");
-        }
         // Check if user already exists
-        else if (find_user_by_name(arg1) != -1) {
+        if (find_user_by_name(arg1) != -1) {
             strcpy(response, "failure (user already exists)");
         } else {
-            // Create new user
-            int new_id = user_count + 1;
-            strcpy(users[user_count].name, arg1);
-            users[user_count].id = new_id;
-            user_count++;
-            
-            sprintf(response, "success %d", new_id);
+            // Create new user (appends the name to the arena and indexes it)
+            int new_id = add_user_entry(arg1);
+            if (new_id == -1) {
+                strcpy(response, "failure (max users reached)");
+            } else {
+                sprintf(response, "success %d", new_id);
+            }
         }
         pthread_rwlock_unlock(&user_lock);
-    } 
+
+        // Durability point (outside the lock so fsync waits don't serialize)
+        if (strncmp(response, "success", 7) == 0) {
+            journal_append(JOP_REGISTER, arg1, NULL);
+        }
+    }
     // --- LOGIC: LEND (Read User, Write Book) ---
     else if (strcmp(command, "Lend") == 0) {
-        // 1. Verify User (Read Lock)
-        pthread_rwlock_rdlock(&user_lock);
-        int user_idx = find_user_by_name(arg2);
-        int user_exists = (user_idx != -1);
-        pthread_rwlock_unlock(&user_lock);
-
-        if (!user_exists) {
+        // 1. Verify User. IMPROVEMENT: Session tokens. Register returns the
+        // new user's id, and a client may present it as "#<id>" in place of
+        // the name; that form resolves with no user_lock and no hash probe.
+        if (!lend_user_exists(arg2)) {
             strcpy(response, "failure (user not found)");
         } else {
-            // 2. Lend Book (Write Lock)
-            pthread_rwlock_wrlock(&book_lock);
+            // 2. Resolve index (Read Lock only; books are never removed,
+            // so the index stays valid after the lock is dropped)
+            stat_rdlock(&book_lock);
             int idx = find_book_index(arg1);
-            if (idx != -1 && books[idx].available) {
-                books[idx].available = 0;
-                strcpy(response, "success");
-            } else {
+            pthread_rwlock_unlock(&book_lock);
+
+            if (idx == -1) {
                 strcpy(response, "failure (book not available)");
+            } else {
+                // 3. Lock-free claim: a single CAS 1 -> 0 on the atomic
+                // availability flag. Exactly one concurrent Lend wins.
+                int expected = 1;
+                if (atomic_compare_exchange_strong(&books[idx].available,
+                                                   &expected, 0)) {
+                    avail_bit_clear(idx);
+                    journal_append(JOP_LEND, arg1, arg2);
+                    strcpy(response, "success");
+                } else {
+                    strcpy(response, "failure (book not available)");
+                }
             }
+        }
+    }
+    // --- LOGIC: LENDWAIT (block until the title is available, bounded) ---
+    else if (strcmp(command, "LendWait") == 0) {
+        if (!lend_user_exists(arg2)) {
+            strcpy(response, "failure (user not found)");
+        } else {
+            stat_rdlock(&book_lock);
+            int idx = find_book_index(arg1);
             pthread_rwlock_unlock(&book_lock);
+
+            if (idx == -1) {
+                strcpy(response, "failure (book not found)");
+            } else if (on_reactor_thread) {
+                // Parking a reactor I/O thread would freeze every other
+                // connection multiplexed on it -- exactly the head-of-line
+                // blocking epoll mode exists to avoid -- so LendWait is
+                // refused there; clients can poll with Lend instead
+                strcpy(response, "failure (LendWait unavailable in epoll mode)");
+            } else {
+                // Park on the title's shard until a Return makes the CAS
+                // succeed or the deadline passes. Return stores the flag
+                // before taking the shard mutex, but its broadcast does
+                // need the mutex -- which we hold from the failed CAS until
+                // the wait -- so the wakeup cannot slip into that window.
+                int shard = book_shard(arg1);
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_sec += LENDWAIT_TIMEOUT_SEC;
+
+                int won = 0;
+                pthread_mutex_lock(&book_shard_locks[shard]);
+                for (;;) {
+                    int expected = 1;
+                    if (atomic_compare_exchange_strong(&books[idx].available,
+                                                       &expected, 0)) {
+                        avail_bit_clear(idx);
+                        won = 1;
+                        break;
+                    }
+                    if (!keep_running) break;
+                    if (pthread_cond_timedwait(&book_shard_conds[shard],
+                                               &book_shard_locks[shard],
+                                               &deadline) == ETIMEDOUT) {
+                        break;
+                    }
+                }
+                pthread_mutex_unlock(&book_shard_locks[shard]);
+
+                if (won) {
+                    journal_append(JOP_LEND, arg1, arg2);
+                    strcpy(response, "success");
+                } else {
+                    strcpy(response, "failure (timeout)");
+                }
+            }
         }
     }
     // --- LOGIC: RETURN (Write Book) ---
     else if (strcmp(command, "Return") == 0) {
-        pthread_rwlock_wrlock(&book_lock);
+        stat_rdlock(&book_lock);
         int idx = find_book_index(arg1);
+        pthread_rwlock_unlock(&book_lock);
+
         if (idx != -1) {
-            books[idx].available = 1;
+            atomic_store(&books[idx].available, 1);
+            avail_bit_set(idx);
+            // Wake any LendWait parked on this title's shard
+            int shard = book_shard(arg1);
+            pthread_mutex_lock(&book_shard_locks[shard]);
+            pthread_cond_broadcast(&book_shard_conds[shard]);
+            pthread_mutex_unlock(&book_shard_locks[shard]);
+            journal_append(JOP_RETURN, arg1, NULL);
             strcpy(response, "success");
         } else {
             strcpy(response, "failure (book not found)");
         }
+    }
+    // --- LOGIC: QUERY (exact-title availability check) ---
+    else if (strcmp(command, "Query") == 0) {
+        stat_rdlock(&book_lock);
+        int idx = find_book_index(arg1);
+        pthread_rwlock_unlock(&book_lock);
+
+        if (idx == -1) {
+            strcpy(response, "failure (book not found)");
+        } else if (atomic_load(&books[idx].available)) {
+            strcpy(response, "success available");
+        } else {
+            strcpy(response, "success lent");
+        }
+    }
+    // --- LOGIC: SEARCH (prefix match over the sorted title index) ---
+    else if (strcmp(command, "Search") == 0) {
+        size_t prefix_len = strlen(arg1);
+        int matched = 0;
+        char list[BUFFER_SIZE / 2];
+        size_t list_len = 0;
+
+        stat_rdlock(&book_lock);
+        // Binary search to the start of the matching run, then walk it
+        for (int pos = title_sorted_lower_bound(arg1); pos < book_count; pos++) {
+            const char *title = book_title(title_sorted[pos]);
+            if (strncmp(title, arg1, prefix_len) != 0) break;
+            matched++;
+            // List as many titles as fit in the response
+            size_t len = strlen(title);
+            if (list_len + len + 1 < sizeof(list)) {
+                list[list_len++] = ' ';
+                memcpy(list + list_len, title, len);
+                list_len += len;
+            }
+        }
         pthread_rwlock_unlock(&book_lock);
+        list[list_len] = '\0';
+
+        if (matched == 0) {
+            strcpy(response, "failure (no matches)");
+        } else {
+            snprintf(response, BUFFER_SIZE, "success %d%s", matched, list);
+        }
     }
     // --- LOGIC: ADD BOOK (Write Book) ---
     else if (strcmp(command, "AddBook") == 0) {
-        pthread_rwlock_wrlock(&book_lock);
-        if (book_count < MAX_BOOKS) {
-            strcpy(books[book_count].title, arg1);
-            books[book_count].available = 1;
-            book_count++;
+        stat_wrlock(&book_lock);
+        if (add_book_entry(arg1) != -1) {
             strcpy(response, "success");
         } else {
             strcpy(response, "failure (library full)");
         }
         pthread_rwlock_unlock(&book_lock);
+
+        if (strncmp(response, "success", 7) == 0) {
+            journal_append(JOP_ADDBOOK, arg1, NULL);
+        }
+    }
+    // --- LOGIC: REPORT (lock-free full-catalog availability scan) ---
+    else if (strcmp(command, "Report") == 0) {
+        // A consistent published count from the RCU snapshot, then a
+        // popcount sweep of the bitmap: no lock, no per-book loads, and
+        // concurrent Lend/Return proceed untouched
+        uint64_t version;
+        int count = catalog_snapshot(&version);
+        long available = avail_bitmap_count(count);
+        snprintf(response, BUFFER_SIZE,
+                 "success total=%d available=%ld lent=%ld version=%lu",
+                 count, available, (long)count - available,
+                 (unsigned long)version);
+    }
+    // --- LOGIC: STATS (dump aggregated performance counters) ---
+    else if (strcmp(command, "Stats") == 0) {
+        int off = snprintf(response, BUFFER_SIZE, "success");
+        unsigned long total_lock_wait = 0;
+        for (int c = 0; c < NUM_CMD_STATS; c++) {
+            unsigned long req = 0, fail = 0, lat = 0;
+            for (int s = 0; s < NUM_STAT_SLOTS; s++) {
+                req  += atomic_load(&stat_slots[s].requests[c]);
+                fail += atomic_load(&stat_slots[s].failures[c]);
+                lat  += atomic_load(&stat_slots[s].latency_ns[c]);
+            }
+            if (req == 0) continue;
+            off += snprintf(response + off, BUFFER_SIZE - off,
+                            " %s=%lu/%lu/%luus", cmd_stat_names[c],
+                            req, fail, lat / req / 1000);
+        }
+        for (int s = 0; s < NUM_STAT_SLOTS; s++) {
+            total_lock_wait += atomic_load(&stat_slots[s].lock_wait_ns);
+        }
+        off += snprintf(response + off, BUFFER_SIZE - off,
+                        " lockwait=%luus", total_lock_wait / 1000);
+        snprintf(response + off, BUFFER_SIZE - off,
+                 " busy=%lu", atomic_load(&busy_rejects));
     } else {
         strcpy(response, "failure (unknown command)");
     }
 
+    // Record per-command counters in this thread's slot
+    StatSlot *sl = stat_slot();
+    int stat_idx = cmd_stat_index(command);
+    atomic_fetch_add(&sl->requests[stat_idx], 1);
+    if (strncmp(response, "failure", 7) == 0) {
+        atomic_fetch_add(&sl->failures[stat_idx], 1);
+    }
+    atomic_fetch_add(&sl->latency_ns[stat_idx], stat_now_ns() - stat_t0);
+
     // Log response
-    snprintf(log_msg, sizeof(log_msg), "Response sent: %s", response);
-    write_log("LIBRARY_THREAD", log_msg);
+    if (event_log_active()) {
+        log_event(COMP_LIBRARY, EV_RESPONSE, response);
+    } else {
+        snprintf(log_msg, sizeof(log_msg), "Response sent: %s", response);
+        write_log("LIBRARY_THREAD", log_msg);
+    }
+}
+
+// --- Process every complete newline-delimited request in inbuf ---
+// Sends one newline-terminated response per request and compacts any
+// partial trailing request to the front of the buffer.
+// IMPROVEMENT: Scatter-gather output. Queued responses are collected as
+// iovec entries -- common fixed responses point straight at static literals
+// with no copy at all -- and flushed with a single writev per received
+// payload, so batched requests cost about one output syscall total.
+#define RESPONSE_IOV_MAX 64
+
+static const char *static_responses[] = {
+    "success\n",
+    "failure (book not available)\n",
+    "failure (book not found)\n",
+    "failure (user not found)\n",
+    "failure (no matches)\n",
+    "failure (timeout)\n",
+    "failure (unknown command)\n",
+};
+#define NUM_STATIC_RESPONSES \
+    (sizeof(static_responses) / sizeof(static_responses[0]))
+
+typedef struct {
+    struct iovec iov[RESPONSE_IOV_MAX];
+    int iovcnt;
+    // Backing store for responses that are not static literals
+    char dynbuf[BUFFER_SIZE * 4];
+    size_t dynlen;
+} ResponseBatch;
+
+void response_batch_flush(int sock, ResponseBatch *rb) {
+    if (rb->iovcnt > 0) {
+        writev(sock, rb->iov, rb->iovcnt);
+    }
+    rb->iovcnt = 0;
+    rb->dynlen = 0;
+}
+
+void response_batch_add(int sock, ResponseBatch *rb, const char *response) {
+    size_t len = strlen(response);
+
+    if (rb->iovcnt == RESPONSE_IOV_MAX ||
+        rb->dynlen + len >= sizeof(rb->dynbuf)) {
+        response_batch_flush(sock, rb);
+    }
+
+    // Fixed responses gather directly from the literal: zero copies
+    for (size_t i = 0; i < NUM_STATIC_RESPONSES; i++) {
+        if (strcmp(response, static_responses[i]) == 0) {
+            rb->iov[rb->iovcnt].iov_base = (void*)static_responses[i];
+            rb->iov[rb->iovcnt].iov_len = len;
+            rb->iovcnt++;
+            return;
+        }
+    }
+
+    // Variable responses (ids, search results) are staged in the batch buffer
+    memcpy(rb->dynbuf + rb->dynlen, response, len);
+    rb->iov[rb->iovcnt].iov_base = rb->dynbuf + rb->dynlen;
+    rb->iov[rb->iovcnt].iov_len = len;
+    rb->iovcnt++;
+    rb->dynlen += len;
+}
+
+void process_lines(int sock, char *inbuf, int *inlen) {
+    inbuf[*inlen] = '\0';
+    char *start = inbuf;
+    char *nl;
+    char response[BUFFER_SIZE];
+    ResponseBatch rb = { .iovcnt = 0, .dynlen = 0 };
+
+    while ((nl = strchr(start, '\n')) != NULL) {
+        *nl = '\0';
+        if (strlen(start) > 0) {
+            memset(response, 0, sizeof(response));
+            process_command(start, response);
+            strcat(response, "\n");
+            response_batch_add(sock, &rb, response);
+        }
+        start = nl + 1;
+    }
+
+    // Keep any partial request for the next read
+    int remaining = *inlen - (int)(start - inbuf);
+    memmove(inbuf, start, remaining);
+    *inlen = remaining;
+
+    // Safety: a full buffer with no newline is treated as one request so a
+    // misbehaving (or old-protocol) client cannot wedge the connection
+    if (*inlen >= BUFFER_SIZE - 1) {
+        inbuf[*inlen] = '\0';
+        memset(response, 0, sizeof(response));
+        process_command(inbuf, response);
+        strcat(response, "\n");
+        response_batch_add(sock, &rb, response);
+        *inlen = 0;
+    }
+
+    response_batch_flush(sock, &rb);
+}
+
+// --- Handler: serve a stream of requests on one socket (worker pool mode) ---
+// IMPROVEMENT: Keep-alive. The connection is served until the client closes
+// it, so each command no longer pays a TCP handshake and teardown.
+void handle_client(int sock) {
+    char inbuf[BUFFER_SIZE];
+    int inlen = 0;
+
+    while (keep_running) {
+        ssize_t bytes_read = read(sock, inbuf + inlen, BUFFER_SIZE - 1 - inlen);
+        if (bytes_read < 0) {
+            // Accepted sockets inherit the listener's 1s SO_RCVTIMEO; a
+            // timeout just means the client is idle between commands
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            perror("Read error");
+            break;
+        }
+        if (bytes_read == 0) break; // Client closed the connection
 
-    send(sock, response, strlen(response), 0);
+        inlen += bytes_read;
+        process_lines(sock, inbuf, &inlen);
+    }
+
+    // Drain on shutdown: answer any requests the client managed to send
+    // before the SIGTERM arrived instead of abandoning them
+    if (!keep_running) {
+        ssize_t bytes_read = recv(sock, inbuf + inlen,
+                                  BUFFER_SIZE - 1 - inlen, MSG_DONTWAIT);
+        if (bytes_read > 0) {
+            inlen += bytes_read;
+            process_lines(sock, inbuf, &inlen);
+        }
+    }
     close(sock);
+}
+
+// --- Worker Pool ---
+// Bounded queue of accepted sockets, drained by long-lived worker threads.
+// Avoids a pthread_create/pthread_detach and a malloc/free per request.
+int socket_queue[SOCKET_QUEUE_SIZE];
+int queue_head = 0, queue_tail = 0, queue_count = 0;
+pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+
+// IMPROVEMENT: Shed load instead of stalling the acceptor. A full pending
+// queue used to block queue_push -- and with it the accept loop -- so an
+// overloaded server stopped accepting entirely and connections piled up in
+// the kernel until they timed out. Now the client gets an immediate busy
+// response and can back off and retry, while the acceptor keeps draining
+// the kernel queue.
+static const char busy_response[] = "failure (server busy, retry later)\n";
+
+void queue_push(int sock) {
+    pthread_mutex_lock(&queue_mutex);
+    if (!keep_running || queue_count == SOCKET_QUEUE_SIZE) {
+        int shedding = keep_running;
+        pthread_mutex_unlock(&queue_mutex);
+        if (shedding) {
+            // Tell the client to retry later rather than silently dropping it
+            send(sock, busy_response, sizeof(busy_response) - 1, MSG_NOSIGNAL);
+            atomic_fetch_add(&busy_rejects, 1);
+        }
+        close(sock);
+        return;
+    }
+    socket_queue[queue_tail] = sock;
+    queue_tail = (queue_tail + 1) % SOCKET_QUEUE_SIZE;
+    queue_count++;
+    pthread_cond_signal(&queue_not_empty);
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+// Returns -1 when the pool is shutting down
+int queue_pop(void) {
+    pthread_mutex_lock(&queue_mutex);
+    while (queue_count == 0 && keep_running) {
+        pthread_cond_wait(&queue_not_empty, &queue_mutex);
+    }
+    if (queue_count == 0) {
+        pthread_mutex_unlock(&queue_mutex);
+        return -1;
+    }
+    int sock = socket_queue[queue_head];
+    queue_head = (queue_head + 1) % SOCKET_QUEUE_SIZE;
+    queue_count--;
+    pthread_mutex_unlock(&queue_mutex);
+    return sock;
+}
+
+void *worker_main(void *arg) {
+    (void)arg;
+    while (1) {
+        int sock = queue_pop();
+        if (sock < 0) break; // Shutdown
+        handle_client(sock);
+    }
     return NULL;
 }
 
-int main() {
-    int server_fd, new_socket, *new_sock;
-    struct sockaddr_in address;
-    int addrlen = sizeof(address);
+// --- Shared-memory Transport (server side) ---
+// IMPROVEMENT: Co-located clients can submit commands through a shared-memory
+// segment (LIBRARY_SHM=1; channel layout in common.h) and skip the TCP stack
+// entirely. One servicing thread per channel blocks on the channel's
+// process-shared condition variable -- a futex wait while idle -- and answers
+// through process_command, the same entry point the socket paths use. Remote
+// clients keep using TCP; nothing here affects the socket paths.
+int shm_enabled = 0;
+int shm_threads_started = 0;
+ShmSegment *shm_segment = NULL;
+pthread_t shm_threads[SHM_CHANNELS];
 
-    // FIX: Install signal handler for graceful shutdown
-    signal(SIGTERM, handle_sigterm);
-    signal(SIGINT, handle_sigterm);
+void *shm_channel_main(void *arg) {
+    ShmChannel *ch = (ShmChannel*)arg;
+    char response[BUFFER_SIZE];
 
-    write_log("LIBRARY", "Library process starting...");
+    while (keep_running) {
+        // A robust-mutex EOWNERDEAD here (a client died mid-operation) is
+        // absorbed by shm_channel_lock: the mutex is made consistent and the
+        // channel reset, so the slot goes straight back into the pool
+        shm_channel_lock(ch);
+        // Timed wait so SIGTERM can break the loop, matching the 1 second
+        // accept timeout on the socket paths
+        while (!ch->has_request && keep_running) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_sec += 1;
+            if (pthread_cond_timedwait(&ch->req_ready, &ch->lock, &ts)
+                    == EOWNERDEAD) {
+                pthread_mutex_consistent(&ch->lock);
+                shm_channel_reset(ch);
+            }
+            // FIX: A client that exits without releasing (crash outside the
+            // critical section) leaks claimed=1 that robust-mutex recovery
+            // never sees; reclaim the channel once its owner is gone
+            if (ch->claimed && ch->owner_pid > 0 &&
+                kill(ch->owner_pid, 0) < 0 && errno == ESRCH) {
+                shm_channel_reset(ch);
+            }
+        }
+        if (!ch->has_request) {
+            pthread_mutex_unlock(&ch->lock);
+            continue; // Shutdown wakeup
+        }
 
-    // Initialize RW Locks
-    pthread_rwlock_init(&user_lock, NULL);
-    pthread_rwlock_init(&book_lock, NULL);
+        memset(response, 0, sizeof(response));
+        process_command(ch->request, response);
+        snprintf(ch->response, sizeof(ch->response), "%s", response);
+        ch->has_request = 0;
+        ch->has_response = 1;
+        pthread_cond_signal(&ch->resp_ready);
+        pthread_mutex_unlock(&ch->lock);
+    }
+    return NULL;
+}
+
+// Create and publish the segment, then start the channel threads
+// (single-threaded startup)
+void shm_transport_init(void) {
+    char *env = getenv("LIBRARY_SHM");
+    if (!env || atoi(env) != 1) return;
+    if (listen_port != PORT) return; // Sharded instances share one segment
+                                     // name; they stay TCP-only
+
+    shm_unlink(SHM_NAME); // Discard any stale segment from a crashed run
+    int fd = shm_open(SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd < 0 || ftruncate(fd, sizeof(ShmSegment)) < 0) {
+        write_log("LIBRARY", "Warning: shared-memory setup failed, TCP only");
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(SHM_NAME);
+        }
+        return;
+    }
+    shm_segment = mmap(NULL, sizeof(ShmSegment), PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm_segment == MAP_FAILED) {
+        write_log("LIBRARY", "Warning: shared-memory map failed, TCP only");
+        shm_segment = NULL;
+        shm_unlink(SHM_NAME);
+        return;
+    }
+
+    // Process-shared mutexes/condvars: futex-based wakeups that cross the
+    // client/library process boundary
+    pthread_mutexattr_t ma;
+    pthread_condattr_t ca;
+    pthread_mutexattr_init(&ma);
+    pthread_mutexattr_setpshared(&ma, PTHREAD_PROCESS_SHARED);
+    // FIX: Robust, so a client dying inside a channel's critical section
+    // hands the lock (with EOWNERDEAD) to the next locker instead of
+    // wedging the servicing thread -- and, through it, shutdown's join
+    pthread_mutexattr_setrobust(&ma, PTHREAD_MUTEX_ROBUST);
+    pthread_condattr_init(&ca);
+    pthread_condattr_setpshared(&ca, PTHREAD_PROCESS_SHARED);
+
+    shm_segment->num_channels = SHM_CHANNELS;
+    for (int i = 0; i < SHM_CHANNELS; i++) {
+        ShmChannel *ch = &shm_segment->channels[i];
+        pthread_mutex_init(&ch->lock, &ma);
+        pthread_cond_init(&ch->req_ready, &ca);
+        pthread_cond_init(&ch->resp_ready, &ca);
+        ch->claimed = ch->has_request = ch->has_response = 0;
+    }
+    pthread_mutexattr_destroy(&ma);
+    pthread_condattr_destroy(&ca);
+    shm_segment->magic = SHM_MAGIC; // Publish: clients may attach now
+
+    for (int i = 0; i < SHM_CHANNELS; i++) {
+        if (pthread_create(&shm_threads[i], NULL, shm_channel_main,
+                           &shm_segment->channels[i]) != 0) {
+            break;
+        }
+        shm_threads_started++;
+    }
+    shm_enabled = 1;
+
+    char log_msg[256];
+    snprintf(log_msg, sizeof(log_msg),
+             "Shared-memory transport enabled: %d channels", shm_threads_started);
+    write_log("LIBRARY", log_msg);
+}
+
+// Join the channel threads and retire the segment (call after SIGTERM, before
+// the snapshot so any in-flight shm operations reach the journal first)
+void shm_transport_shutdown(void) {
+    if (!shm_enabled) return;
+    for (int i = 0; i < shm_threads_started; i++) {
+        pthread_join(shm_threads[i], NULL);
+    }
+    munmap(shm_segment, sizeof(ShmSegment));
+    shm_unlink(SHM_NAME);
+    shm_enabled = 0;
+}
+
+// --- Epoll Reactor ---
+// A few I/O threads multiplex all client sockets instead of dedicating a
+// blocking thread per connection. Per-connection cost drops from a full
+// thread stack to one small Connection struct, and connections stay open
+// across requests.
+typedef struct Connection {
+    int fd;
+    char inbuf[BUFFER_SIZE];
+    int inlen;
+    struct Connection *next_free; // Pool free-list link (unused while live)
+} Connection;
+
+int epoll_fds[MAX_IO_THREADS];
+int num_io_threads = DEFAULT_IO_THREADS;
+
+// IMPROVEMENT: Slab pool for connection state. Connections are carved from
+// slabs in chunks and recycled through a free list on disconnect, so
+// steady-state connection setup is a list pop instead of a malloc and the
+// heap never fragments under connection churn.
+#define CONN_POOL_CHUNK 256
+
+Connection *conn_free_list = NULL;
+pthread_mutex_t conn_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+Connection *conn_alloc(void) {
+    pthread_mutex_lock(&conn_pool_mutex);
+    if (conn_free_list == NULL) {
+        // Grow the pool by one slab and thread it onto the free list
+        Connection *slab = malloc(CONN_POOL_CHUNK * sizeof(Connection));
+        if (!slab) {
+            pthread_mutex_unlock(&conn_pool_mutex);
+            return NULL;
+        }
+        for (int i = 0; i < CONN_POOL_CHUNK; i++) {
+            slab[i].next_free = conn_free_list;
+            conn_free_list = &slab[i];
+        }
+    }
+    Connection *conn = conn_free_list;
+    conn_free_list = conn->next_free;
+    pthread_mutex_unlock(&conn_pool_mutex);
+    return conn;
+}
+
+void conn_release(Connection *conn) {
+    pthread_mutex_lock(&conn_pool_mutex);
+    conn->next_free = conn_free_list;
+    conn_free_list = conn;
+    pthread_mutex_unlock(&conn_pool_mutex);
+}
+
+void conn_close(int epfd, Connection *conn) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+    close(conn->fd);
+    conn_release(conn); // Back to the pool, not the heap
+}
+
+// Handle readable data on one connection. Each chunk received is treated
+// as one request; the connection stays open for the next one.
+void conn_readable(int epfd, Connection *conn) {
+    ssize_t bytes_read = read(conn->fd, conn->inbuf + conn->inlen,
+                              BUFFER_SIZE - 1 - conn->inlen);
+    if (bytes_read <= 0) {
+        // Peer closed (or error): drop the connection state
+        conn_close(epfd, conn);
+        return;
+    }
+    conn->inlen += bytes_read;
+    process_lines(conn->fd, conn->inbuf, &conn->inlen);
+}
+
+void *reactor_main(void *arg) {
+    int epfd = *(int*)arg;
+    struct epoll_event events[MAX_EPOLL_EVENTS];
+    on_reactor_thread = 1; // Blocking handlers must refuse on this thread
 
-    // IMPROVEMENT: Load books from configuration file (dynamic)
-    if (load_books_from_file("books.conf") == 0) {
-        // Fallback: Pre-populate a few default books if config file not found
-        strcpy(books[0].title, "Harry_Potter"); 
-        books[0].available = 1;
-        strcpy(books[1].title, "1984"); 
-        books[1].available = 1;
-        strcpy(books[2].title, "To_Kill_a_Mockingbird"); 
-        books[2].available = 1;
-        book_count = 3;
-        write_log("LIBRARY", "Using 3 default books");
-    }
-
-    // Socket Setup
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd == -1) {
+    while (keep_running) {
+        // 1 second timeout so SIGTERM can break the loop
+        int n = epoll_wait(epfd, events, MAX_EPOLL_EVENTS, 1000);
+        for (int i = 0; i < n; i++) {
+            conn_readable(epfd, (Connection*)events[i].data.ptr);
+        }
+    }
+
+    // Drain on shutdown: one zero-timeout pass answers whatever was already
+    // readable when the SIGTERM arrived
+    int n = epoll_wait(epfd, events, MAX_EPOLL_EVENTS, 0);
+    for (int i = 0; i < n; i++) {
+        conn_readable(epfd, (Connection*)events[i].data.ptr);
+    }
+    return NULL;
+}
+
+// Register a newly accepted socket, round-robin across the I/O threads'
+// epoll instances.
+void reactor_add_connection(int sock) {
+    // Atomic: multiple acceptor threads may register connections concurrently
+    static atomic_int next_epoll = 0;
+    Connection *conn = conn_alloc();
+    if (!conn) {
+        close(sock);
+        return;
+    }
+    conn->fd = sock;
+    conn->inlen = 0;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = conn;
+    int epfd = epoll_fds[atomic_fetch_add(&next_epoll, 1) % num_io_threads];
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &ev) < 0) {
+        perror("epoll_ctl add failed");
+        close(sock);
+        conn_release(conn);
+    }
+}
+
+// --- Listen Socket / Acceptors ---
+// IMPROVEMENT: Multi-acceptor mode (LIBRARY_ACCEPTORS=N). Each acceptor
+// thread binds its own SO_REUSEPORT socket on PORT and the kernel load
+// balances incoming connections across them, so connection establishment is
+// no longer funneled through one accept queue.
+int epoll_mode = 0; // Set from LIBRARY_EPOLL before the acceptors start
+int listen_backlog = DEFAULT_LISTEN_BACKLOG; // LIBRARY_BACKLOG overrides
+
+int create_listen_socket(int use_reuseport) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
         perror("Socket creation failed");
-        return 1;
+        return -1;
     }
 
     int opt = 1;
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
         perror("setsockopt failed");
-        close(server_fd);
-        return 1;
+        close(fd);
+        return -1;
+    }
+
+    if (use_reuseport &&
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("setsockopt SO_REUSEPORT failed");
+        close(fd);
+        return -1;
     }
 
     // FIX: Set accept timeout so SIGTERM can interrupt the blocking call
     struct timeval tv;
     tv.tv_sec = 1;  // 1 second timeout on accept
     tv.tv_usec = 0;
-    if (setsockopt(server_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
         perror("setsockopt timeout failed");
-        close(server_fd);
-        return 1;
+        close(fd);
+        return -1;
     }
-    
+
+    struct sockaddr_in address;
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(PORT);
+    address.sin_port = htons(listen_port);
 
-    if (bind(server_fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
         perror("Bind failed");
-        close(server_fd);
-        return 1;
+        close(fd);
+        return -1;
     }
 
-    if (listen(server_fd, 5) < 0) {
+    if (listen(fd, listen_backlog) < 0) {
         perror("Listen failed");
-        close(server_fd);
-        return 1;
+        close(fd);
+        return -1;
     }
+    return fd;
+}
 
-    write_log("LIBRARY", "Server listening on port 8080...");
+// Accept connections until shutdown, dispatching to the active mode
+void accept_loop(int server_fd) {
+    struct sockaddr_in address;
+    int addrlen = sizeof(address);
 
     // FIX: Use signal handler to break loop gracefully
     while (keep_running) {
-        new_socket = accept(server_fd, (struct sockaddr *)&address, (socklen_t*)&addrlen);
-        
+        int new_socket = accept(server_fd, (struct sockaddr *)&address,
+                                (socklen_t*)&addrlen);
+
         // Check if we got shutdown signal (accept timeout or signal)
         if (!keep_running) break;
-        
+
         if (new_socket < 0) {
             // Timeout occurred (normal, part of graceful shutdown mechanism)
             continue;
         }
 
-        pthread_t handler_thread;
-        new_sock = malloc(sizeof(int));
-        *new_sock = new_socket;
-        
-        // Spawn Thread for this request
-        if (pthread_create(&handler_thread, NULL, client_handler, (void*)new_sock) < 0) {
-            perror("Could not create thread");
-            free(new_sock);
-            close(new_socket);
-            continue;
+        if (epoll_mode) {
+            reactor_add_connection(new_socket);
+        } else {
+            // Hand the socket to the worker pool (no thread spawn, no malloc)
+            queue_push(new_socket);
+        }
+    }
+}
+
+void *acceptor_main(void *arg) {
+    int fd = *(int*)arg;
+    accept_loop(fd);
+    return NULL;
+}
+
+int main() {
+    int server_fd;
+
+    // FIX: Install signal handler for graceful shutdown
+    signal(SIGTERM, handle_sigterm);
+    signal(SIGINT, handle_sigterm);
+
+    write_log("LIBRARY", "Library process starting...");
+    log_event(COMP_LIBRARY, EV_STARTUP, NULL);
+
+    // IMPROVEMENT: Instance port override (LIBRARY_PORT), used by the
+    // sharded deployment where N instances on consecutive ports each own a
+    // title-hash range. Non-default instances keep their own snapshot and
+    // journal files.
+    char *port_env = getenv("LIBRARY_PORT");
+    if (port_env && atoi(port_env) > 0) {
+        listen_port = atoi(port_env);
+        if (listen_port != PORT) {
+            snprintf(snapshot_path, sizeof(snapshot_path), "%s.%d",
+                     SNAPSHOT_FILE, listen_port);
+            snprintf(journal_path, sizeof(journal_path), "%s.%d",
+                     JOURNAL_FILE, listen_port);
+        }
+    }
+
+    // FIX: In a sharded deployment each instance owns one slot of the title
+    // hash ring (its port offset), so preloading can skip foreign titles --
+    // previously every shard loaded the whole catalog and cross-shard Search
+    // merges returned the same title once per shard
+    shard_count = client_num_shards();
+    if (shard_count > 1) {
+        shard_index = listen_port - PORT;
+        if (shard_index < 0 || shard_index >= shard_count) shard_index = 0;
+        char shard_msg[128];
+        snprintf(shard_msg, sizeof(shard_msg),
+                 "Shard %d of %d (preloading owned titles only)",
+                 shard_index, shard_count);
+        write_log("LIBRARY", shard_msg);
+    }
+
+    // Initialize RW Locks
+    pthread_rwlock_init(&user_lock, NULL);
+    pthread_rwlock_init(&book_lock, NULL);
+    for (int i = 0; i < NUM_BOOK_SHARDS; i++) {
+        pthread_mutex_init(&book_shard_locks[i], NULL);
+        pthread_cond_init(&book_shard_conds[i], NULL);
+    }
+
+    // Reserve tables/arenas and empty hash indexes before anything is added
+    storage_init();
+
+    // IMPROVEMENT: Restore from the binary snapshot when one exists (fast
+    // mmap path); fall back to parsing the text config on first start
+    if (load_snapshot() > 0) {
+        // Tables and indexes restored, nothing else to do
+    }
+    else if (load_books_from_file("books.conf") < 0) {
+        // Fallback: Pre-populate a few default books if config file not
+        // found (only the ones this shard owns, like the config path)
+        static const char *default_books[] = {
+            "Harry_Potter", "1984", "To_Kill_a_Mockingbird"
+        };
+        for (size_t i = 0; i < sizeof(default_books) / sizeof(*default_books); i++) {
+            if (title_owned_here(default_books[i])) {
+                add_book_entry(default_books[i]);
+            }
+        }
+        write_log("LIBRARY", "Using default books");
+    }
+
+    // IMPROVEMENT: Replay any crash-surviving journal and start the group
+    // committer (LIBRARY_JOURNAL=1)
+    journal_init();
+
+    // IMPROVEMENT: Shared-memory channels for co-located clients
+    // (LIBRARY_SHM=1)
+    shm_transport_init();
+
+    // Socket Setup: one listen socket by default, N SO_REUSEPORT sockets in
+    // multi-acceptor mode
+    char *backlog_env = getenv("LIBRARY_BACKLOG");
+    if (backlog_env && atoi(backlog_env) > 0) {
+        listen_backlog = atoi(backlog_env);
+    }
+
+    int num_acceptors = 1;
+    char *acceptors_env = getenv("LIBRARY_ACCEPTORS");
+    if (acceptors_env && atoi(acceptors_env) > 0 && atoi(acceptors_env) <= MAX_ACCEPTORS) {
+        num_acceptors = atoi(acceptors_env);
+    }
+
+    server_fd = create_listen_socket(num_acceptors > 1);
+    if (server_fd < 0) {
+        return 1;
+    }
+
+    char listen_msg[64];
+    snprintf(listen_msg, sizeof(listen_msg),
+             "Server listening on port %d...", listen_port);
+    write_log("LIBRARY", listen_msg);
+
+    // IMPROVEMENT: Two dispatch modes.
+    //   Default: fixed pool of worker threads (size via LIBRARY_WORKERS)
+    //   LIBRARY_EPOLL=1: epoll reactor with a few I/O threads
+    char *epoll_env = getenv("LIBRARY_EPOLL");
+    epoll_mode = (epoll_env && atoi(epoll_env) == 1);
+
+    int num_workers = DEFAULT_WORKERS;
+    char *workers_env = getenv("LIBRARY_WORKERS");
+    if (workers_env && atoi(workers_env) > 0) {
+        num_workers = atoi(workers_env);
+    }
+
+    char *io_env = getenv("LIBRARY_IO_THREADS");
+    if (io_env && atoi(io_env) > 0 && atoi(io_env) <= MAX_IO_THREADS) {
+        num_io_threads = atoi(io_env);
+    }
+
+    pthread_t workers[epoll_mode ? num_io_threads : num_workers];
+    if (epoll_mode) {
+        for (int i = 0; i < num_io_threads; i++) {
+            epoll_fds[i] = epoll_create1(0);
+            if (epoll_fds[i] < 0) {
+                perror("epoll_create1 failed");
+                close(server_fd);
+                return 1;
+            }
+            if (pthread_create(&workers[i], NULL, reactor_main, &epoll_fds[i]) != 0) {
+                perror("I/O thread creation failed");
+                close(server_fd);
+                return 1;
+            }
         }
+        char mode_msg[256];
+        snprintf(mode_msg, sizeof(mode_msg), "Epoll reactor mode: %d I/O threads", num_io_threads);
+        write_log("LIBRARY", mode_msg);
+    } else {
+        for (int i = 0; i < num_workers; i++) {
+            if (pthread_create(&workers[i], NULL, worker_main, NULL) != 0) {
+                perror("Worker thread creation failed");
+                close(server_fd);
+                return 1;
+            }
+        }
+        char mode_msg[256];
+        snprintf(mode_msg, sizeof(mode_msg), "Started %d worker threads", num_workers);
+        write_log("LIBRARY", mode_msg);
+    }
+
+    // Extra acceptors, each on its own SO_REUSEPORT listen socket; the main
+    // thread serves as acceptor 0
+    int acceptor_fds[MAX_ACCEPTORS];
+    pthread_t acceptor_threads[MAX_ACCEPTORS];
+    for (int i = 1; i < num_acceptors; i++) {
+        acceptor_fds[i] = create_listen_socket(1);
+        if (acceptor_fds[i] < 0 ||
+            pthread_create(&acceptor_threads[i], NULL, acceptor_main,
+                           &acceptor_fds[i]) != 0) {
+            perror("Acceptor setup failed");
+            close(server_fd);
+            return 1;
+        }
+    }
+    if (num_acceptors > 1) {
+        char acc_msg[256];
+        snprintf(acc_msg, sizeof(acc_msg),
+                 "Multi-acceptor mode: %d SO_REUSEPORT acceptors", num_acceptors);
+        write_log("LIBRARY", acc_msg);
+    }
 
-        // Detach thread so resources are freed automatically
-        pthread_detach(handler_thread);
+    // IMPROVEMENT: Readiness handshake. When the builder passed us a pipe
+    // (LIBRARY_READY_FD), signal it now that the listen sockets and handler
+    // threads are live, so it starts clients without polling the port
+    char *ready_env = getenv("LIBRARY_READY_FD");
+    if (ready_env && atoi(ready_env) > 0) {
+        int ready_fd = atoi(ready_env);
+        if (write(ready_fd, "R", 1) < 0) {
+            write_log("LIBRARY", "Warning: readiness signal failed");
+        }
+        close(ready_fd);
     }
 
+    accept_loop(server_fd);
+
     // FIX: Now this cleanup code is reachable!
     write_log("LIBRARY", "Shutting down, closing server...");
+
+    for (int i = 1; i < num_acceptors; i++) {
+        pthread_join(acceptor_threads[i], NULL);
+        close(acceptor_fds[i]);
+    }
+
+    if (epoll_mode) {
+        for (int i = 0; i < num_io_threads; i++) {
+            pthread_join(workers[i], NULL);
+            close(epoll_fds[i]);
+        }
+    } else {
+        // Wake workers so they see keep_running == 0 and exit
+        pthread_mutex_lock(&queue_mutex);
+        pthread_cond_broadcast(&queue_not_empty);
+        pthread_mutex_unlock(&queue_mutex);
+        for (int i = 0; i < num_workers; i++) {
+            pthread_join(workers[i], NULL);
+        }
+    }
+
+    // Quiesce the shared-memory channels with the other handler threads
+    shm_transport_shutdown();
+
+    // Persist state so the next start recovers it via mmap (handlers are
+    // quiesced at this point), then retire the journal the snapshot covers
+    save_snapshot();
+    journal_shutdown();
+
     close(server_fd);
     pthread_rwlock_destroy(&user_lock);
     pthread_rwlock_destroy(&book_lock);
+    for (int i = 0; i < NUM_BOOK_SHARDS; i++) {
+        pthread_mutex_destroy(&book_shard_locks[i]);
+        pthread_cond_destroy(&book_shard_conds[i]);
+    }
+    log_event(COMP_LIBRARY, EV_SHUTDOWN, NULL);
     write_log("LIBRARY", "Clean shutdown completed.");
     return 0;
 }
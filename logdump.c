@@ -0,0 +1,60 @@
+// logdump.c
+// Offline renderer for the binary event log (see the Binary Event Log
+// section in common.h). The server writes fixed-size records with no
+// formatting cost; this tool pays the formatting here instead, where it
+// does not sit on the request path.
+//
+// Usage: ./logdump [file]   (default: log.events)
+// Output: one line per record, timestamps relative to the first record.
+#include "common.h"
+
+static const char *component_name(uint16_t component) {
+    switch (component) {
+        case COMP_LIBRARY: return "LIBRARY";
+        case COMP_CLIENT:  return "CLIENT";
+        case COMP_BUILDER: return "BUILDER";
+        default:           return "UNKNOWN";
+    }
+}
+
+static const char *event_name(uint16_t event) {
+    switch (event) {
+        case EV_REQUEST:  return "request";
+        case EV_RESPONSE: return "response";
+        case EV_STARTUP:  return "startup";
+        case EV_SHUTDOWN: return "shutdown";
+        default:          return "unknown";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = (argc > 1) ? argv[1] : EVENT_LOG_FILE;
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "logdump: could not open %s\n", path);
+        return 1;
+    }
+
+    EventRecord rec;
+    uint64_t first_ts = 0;
+    long count = 0;
+    while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+        if (count == 0) first_ts = rec.ts_ns;
+        uint64_t rel = rec.ts_ns - first_ts;
+
+        // Payload length is caller-supplied on disk: clamp before printing
+        uint32_t len = rec.payload_len;
+        if (len > EVENT_PAYLOAD_MAX) len = EVENT_PAYLOAD_MAX;
+
+        printf("%6llu.%06llums %-8s %-8s %.*s\n",
+               (unsigned long long)(rel / 1000000ull),
+               (unsigned long long)(rel % 1000000ull),
+               component_name(rec.component), event_name(rec.event),
+               (int)len, rec.payload);
+        count++;
+    }
+    fclose(fp);
+
+    fprintf(stderr, "logdump: %ld records from %s\n", count, path);
+    return 0;
+}